@@ -1,4 +1,5 @@
 #include "bitmaps.h"
+#include <assert.h>
 
 const uint8_t bitmap_splash_screen[] = {
     0x00, 0xc0, 0xd8, 0x30, 0x00, 0x80, 0x07, 0x00, 0x00, 0x60, 0x30, 0x00, 0x03, 0x06, 0x00, 0x00,
@@ -67,85 +68,49 @@ const uint8_t bitmap_splash_screen[] = {
     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xfe, 0xff, 0xff, 0x3f, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 };
 
-const uint8_t bitmap_default_screen[] = {
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0xc0, 0xd8, 0x30, 0x00, 0x80, 0x07, 0x00, 0x00, 0x60, 0x30, 0x00, 0x03, 0x06, 0x00, 0x00,
-    0x00, 0xc0, 0x18, 0x30, 0x00, 0xc0, 0x0c, 0x00, 0x00, 0xe0, 0x38, 0x00, 0x03, 0x06, 0x00, 0x00,
-    0x00, 0x80, 0xcd, 0x3c, 0xc7, 0x61, 0xc8, 0xd1, 0xc6, 0xe1, 0x38, 0xc7, 0xdb, 0xe6, 0x00, 0x00,
-    0x00, 0x80, 0xcd, 0xb6, 0x6d, 0x63, 0x20, 0xb3, 0x6d, 0xe3, 0xbd, 0x6d, 0xdb, 0xb6, 0x01, 0x00,
-    0x00, 0x80, 0xcd, 0xb6, 0x6f, 0x63, 0xce, 0xb3, 0xed, 0x63, 0xb5, 0x6d, 0xdb, 0xf6, 0x01, 0x00,
-    0x00, 0x00, 0xc7, 0xb6, 0x61, 0x63, 0x6c, 0xb3, 0x6d, 0x60, 0xb7, 0x6d, 0xdb, 0x36, 0x00, 0x00,
-    0x00, 0x00, 0xc7, 0xb6, 0x6d, 0xc3, 0x6c, 0xb3, 0x6d, 0x63, 0xb2, 0x6d, 0xdb, 0xb6, 0x01, 0x00,
-    0x00, 0x00, 0xc2, 0x3c, 0xc7, 0x81, 0xcb, 0xb6, 0xcd, 0x61, 0x32, 0xc7, 0xb3, 0xe6, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x03, 0x66, 0x06, 0xd8, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x60, 0x00, 0x18, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0xa0, 0x71, 0x1e, 0x6b, 0xf6, 0xe6, 0xd8, 0x3e, 0xc7, 0x03, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x60, 0xdb, 0x0c, 0xdb, 0x66, 0x96, 0xd9, 0xb0, 0x6d, 0x03, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x60, 0xdb, 0x0c, 0xdb, 0x66, 0xe6, 0xd9, 0x98, 0x6f, 0x03, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x60, 0xdb, 0x0c, 0xdb, 0x66, 0xb6, 0xd9, 0x8c, 0x61, 0x03, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x60, 0xdb, 0x0c, 0xdb, 0x66, 0xb6, 0xd9, 0x86, 0x6d, 0x03, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x60, 0x73, 0x18, 0xdb, 0xc6, 0x66, 0xdb, 0x3e, 0xc7, 0x03, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x22, 0x80, 0x80, 0x00, 0x5e, 0x01, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00, 0x00,
-    0x22, 0x80, 0x80, 0x00, 0x42, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0xa2, 0xe3, 0xdc, 0x19, 0x42, 0x9d, 0x63, 0x0a, 0x88, 0x29, 0x86, 0x54, 0x6e, 0x92, 0x5c, 0x31,
-    0xa2, 0x94, 0x92, 0x24, 0x4e, 0xa5, 0x94, 0x14, 0x44, 0x52, 0x89, 0xa5, 0x92, 0x92, 0x92, 0x4a,
-    0xa2, 0x94, 0x92, 0x3c, 0x42, 0xa5, 0xf4, 0x04, 0xc2, 0x13, 0x89, 0x24, 0x92, 0x92, 0x92, 0x78,
-    0xa2, 0x94, 0x92, 0x04, 0x42, 0xa5, 0x14, 0x04, 0x41, 0x10, 0x89, 0x24, 0x92, 0x92, 0x92, 0x08,
-    0x9c, 0xe3, 0x9c, 0x18, 0x42, 0x9d, 0x63, 0x04, 0x9f, 0x11, 0x86, 0x24, 0x92, 0x6c, 0x9c, 0x30,
-    0x80, 0x00, 0x00, 0x00, 0x00, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x80, 0x00, 0x00, 0x00, 0x00, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf0, 0x97, 0xd5, 0x1f,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x74, 0x47, 0x10,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xd0, 0xc5, 0x57, 0x17,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xd0, 0x45, 0x56, 0x17,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xd0, 0xf5, 0x44, 0x17,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x94, 0x56, 0x10,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf0, 0x57, 0xd5, 0x1f,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xd0, 0x11, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x70, 0x76, 0xf8, 0x19,
-    0x00, 0xa8, 0x00, 0x00, 0x00, 0x00, 0x84, 0x00, 0x40, 0x00, 0x00, 0x08, 0xd0, 0x62, 0x58, 0x1a,
-    0x00, 0x24, 0x00, 0x00, 0x00, 0x00, 0x84, 0x00, 0x40, 0x00, 0x00, 0x18, 0x90, 0x9e, 0x9a, 0x16,
-    0x28, 0xa4, 0xce, 0x31, 0x85, 0x63, 0x4e, 0xd2, 0x71, 0x00, 0x00, 0x38, 0x70, 0x3b, 0x44, 0x02,
-    0x50, 0xac, 0x52, 0x4a, 0x8a, 0x94, 0x44, 0x52, 0x4a, 0xf0, 0xff, 0x7f, 0xe0, 0xa5, 0x49, 0x10,
-    0x10, 0xa4, 0x52, 0x7a, 0x82, 0xf4, 0x44, 0x52, 0x4a, 0x00, 0x00, 0x38, 0x80, 0x1a, 0xdd, 0x18,
-    0x10, 0xa4, 0x52, 0x0a, 0x82, 0x14, 0x24, 0x52, 0x4a, 0x00, 0x00, 0x18, 0xf0, 0x2e, 0x5b, 0x16,
-    0x10, 0xa5, 0xce, 0x31, 0xa2, 0x64, 0x24, 0xdc, 0x71, 0x00, 0x00, 0x08, 0x40, 0x81, 0xc1, 0x03,
-    0x00, 0x00, 0x42, 0x00, 0x00, 0x00, 0x20, 0x40, 0x00, 0x00, 0x00, 0x00, 0xb0, 0x0e, 0xfd, 0x09,
-    0x00, 0x00, 0x42, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 0x1a, 0x11,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf0, 0xc7, 0x51, 0x11,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x14, 0x1d, 0x09,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xd0, 0xa5, 0xf9, 0x09,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xd0, 0xa5, 0x2d, 0x0d,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xd0, 0x95, 0xab, 0x1b,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x54, 0xf4, 0x01,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf0, 0xb7, 0x70, 0x12,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-};
+// 8x8 bit matrix transpose (Hacker's Delight, 7-3): out[c] bit r = in[r * stride] bit c.
+// The rows are loaded in reverse, so the MSB-first original works on LSB-first XBM bits.
+static void bitmap_transpose8(const uint8_t* in, size_t stride, uint8_t* out) {
+    uint32_t x = ((uint32_t)in[7 * stride] << 24) | ((uint32_t)in[6 * stride] << 16) |
+                 ((uint32_t)in[5 * stride] << 8) | in[4 * stride];
+    uint32_t y = ((uint32_t)in[3 * stride] << 24) | ((uint32_t)in[2 * stride] << 16) |
+                 ((uint32_t)in[1 * stride] << 8) | in[0];
+    uint32_t t;
+
+    t = (x ^ (x >> 7)) & 0x00AA00AA;
+    x = x ^ t ^ (t << 7);
+    t = (y ^ (y >> 7)) & 0x00AA00AA;
+    y = y ^ t ^ (t << 7);
+
+    t = (x ^ (x >> 14)) & 0x0000CCCC;
+    x = x ^ t ^ (t << 14);
+    t = (y ^ (y >> 14)) & 0x0000CCCC;
+    y = y ^ t ^ (t << 14);
+
+    t = (x & 0xF0F0F0F0) | ((y >> 4) & 0x0F0F0F0F);
+    y = ((x << 4) & 0xF0F0F0F0) | (y & 0x0F0F0F0F);
+    x = t;
+
+    out[7] = x >> 24;
+    out[6] = x >> 16;
+    out[5] = x >> 8;
+    out[4] = x;
+    out[3] = y >> 24;
+    out[2] = y >> 16;
+    out[1] = y >> 8;
+    out[0] = y;
+}
 
 void bitmap_xbm_to_screen_frame(uint8_t* dst, const uint8_t* src, size_t w, size_t h) {
-    for(size_t y = 0; y < h; ++y) {
-        for(size_t x = 0; x < w; ++x) {
-            const size_t ii = (y * w + x) / 8;
-            const size_t oi = y / 8 * w + x;
+    assert(w % 8 == 0 && h % 8 == 0);
 
-            const size_t iz = x % 8;
-            const size_t oz = y % 8;
+    const size_t stride = w / 8;
 
-            if(src[ii] & (1 << iz)) {
-                dst[oi] = dst[oi] | (1 << oz);
-            }
+    // One 8x8 block is 8 XBM row bytes in, 8 page column bytes out
+    for(size_t page = 0; page < h / 8; page++) {
+        for(size_t column = 0; column < stride; column++) {
+            bitmap_transpose8(
+                &src[page * 8 * stride + column], stride, &dst[page * w + column * 8]);
         }
     }
 }
@@ -9,6 +9,9 @@
 #define FLIPPER_BITMAP_SIZE (FLIPPER_SCREEN_WIDTH * FLIPPER_SCREEN_HEIGHT / 8)
 
 extern const uint8_t bitmap_splash_screen[FLIPPER_BITMAP_SIZE];
-extern const uint8_t bitmap_default_screen[FLIPPER_BITMAP_SIZE];
 
+/**
+ * Convert an XBM bitmap into the Flipper screen frame format, one byte per 8-row column.
+ * The whole of dst is written. w and h must be multiples of 8.
+ */
 void bitmap_xbm_to_screen_frame(uint8_t* dst, const uint8_t* src, size_t w, size_t h);
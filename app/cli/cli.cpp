@@ -1,17 +1,33 @@
 #include "cli_commands.h"
 #include <FreeRTOS.h>
 #include <task.h>
+#include <pico/stdlib.h>
+#include <tusb.h>
 #include <algorithm>
-#include <functional>
-#include <cctype>
-#include <locale>
 #include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
 
+// Longest command line, longer input is refused with a bell
+#define CLI_LINE_SIZE 128
+// Same as the CDC TX FIFO, so a full buffer goes out as one transfer
+#define CLI_OUTPUT_SIZE 256
+// Output is dropped if the host doesn't read it for this long
+#define CLI_OUTPUT_TIMEOUT_MS 100
+
+#define CLI_WHITESPACE " \t\r\n\v\f"
+
+// Nothing here is heap allocated, the heap is left to the video pipeline
 struct Cli {
-    std::string line;
-    std::string prev_line;
+    char line[CLI_LINE_SIZE];
+    size_t line_size;
+    char prev_line[CLI_LINE_SIZE];
+    size_t prev_line_size;
     size_t cursor_position;
     bool esc_mode;
+    CliArgs args;
+    char output[CLI_OUTPUT_SIZE];
+    size_t output_size;
 };
 
 typedef enum {
@@ -28,59 +44,58 @@ typedef enum {
     Del = 0x7F,
 } CliSymbol;
 
+static void cli_write_data(Cli* cli, const char* data, size_t size);
+
 static void cli_reset(Cli* cli) {
-    cli->line.clear();
+    cli->line_size = 0;
     cli->cursor_position = 0;
 }
 
-// trim from start
-static inline std::string& ltrim(std::string& s) {
-    s.erase(
-        s.begin(),
-        std::find_if(s.begin(), s.end(), std::not1(std::ptr_fun<int, int>(std::isspace))));
-    return s;
-}
+static std::string_view cli_trim(std::string_view s) {
+    const size_t start = s.find_first_not_of(CLI_WHITESPACE);
+    if(start == std::string_view::npos) {
+        return std::string_view();
+    }
 
-// trim from end
-static inline std::string& rtrim(std::string& s) {
-    s.erase(
-        std::find_if(s.rbegin(), s.rend(), std::not1(std::ptr_fun<int, int>(std::isspace))).base(),
-        s.end());
-    return s;
+    const size_t end = s.find_last_not_of(CLI_WHITESPACE);
+    return s.substr(start, end - start + 1);
 }
 
-// trim from both ends
-static inline std::string& trim(std::string& s) {
-    return ltrim(rtrim(s));
-}
+// cli_items is sorted by name
+static const CliItem* cli_search_item(std::string_view name) {
+    size_t low = 0;
+    size_t high = cli_items_count;
 
-static const CliItem* cli_search_item(Cli* cli, const std::string& name) {
-    for(size_t i = 0; i < cli_items_count; i++) {
-        if(name == cli_items[i].name) {
-            return &cli_items[i];
+    while(low < high) {
+        const size_t middle = (low + high) / 2;
+        const int order = name.compare(cli_items[middle].name);
+        if(order == 0) {
+            return &cli_items[middle];
+        } else if(order < 0) {
+            high = middle;
+        } else {
+            low = middle + 1;
         }
     }
+
     return NULL;
 }
 
 static void cli_handle_enter(Cli* cli) {
-    std::string command = "";
-    std::string args = "";
-    const CliItem* item = NULL;
+    memcpy(cli->prev_line, cli->line, cli->line_size);
+    cli->prev_line_size = cli->line_size;
 
-    cli->prev_line = cli->line;
-    cli->line = trim(cli->line);
+    const std::string_view line = cli_trim(std::string_view(cli->line, cli->line_size));
+    std::string_view command = line;
+    std::string_view args;
 
-    size_t ws = cli->line.find_first_of(" ");
-    if(ws == std::string::npos) {
-        command = cli->line;
-    } else {
-        command = cli->line.substr(0, ws);
-        args = cli->line.substr(ws + 1);
-        args = trim(args);
+    size_t ws = line.find_first_of(' ');
+    if(ws != std::string_view::npos) {
+        command = line.substr(0, ws);
+        args = cli_trim(line.substr(ws + 1));
     }
 
-    item = cli_search_item(cli, command);
+    const CliItem* item = cli_search_item(command);
     if(item != NULL) {
         item->callback(cli, args);
     } else {
@@ -89,11 +104,15 @@ static void cli_handle_enter(Cli* cli) {
 }
 
 static void cli_handle_backspace(Cli* cli) {
-    if(cli->line.size() > 0 && cli->cursor_position > 0) {
+    if(cli->line_size > 0 && cli->cursor_position > 0) {
         // Other side
         cli_write_str(cli, "\e[D\e[1P");
         // Our side
-        cli->line.erase(cli->cursor_position - 1, 1);
+        memmove(
+            &cli->line[cli->cursor_position - 1],
+            &cli->line[cli->cursor_position],
+            cli->line_size - cli->cursor_position);
+        cli->line_size--;
         cli->cursor_position--;
     } else {
         cli_write_char(cli, CliSymbol::Bell);
@@ -104,7 +123,6 @@ static void cli_force_motd(Cli* cli) {
     // cli_write_motd(cli);
     cli_write_eol(cli);
     cli_write_prompt(cli);
-    cli_flush(cli);
 }
 
 static void cli_handle_char(Cli* cli, uint8_t c) {
@@ -114,12 +132,13 @@ static void cli_handle_char(Cli* cli, uint8_t c) {
             cli->esc_mode = true;
             break;
         case 'A': // Up
-            if(cli->line.size() == 0 && cli->line != cli->prev_line) {
+            if(cli->line_size == 0 && cli->prev_line_size > 0) {
                 // Set line buffer and cursor position
-                cli->line = cli->prev_line;
-                cli->cursor_position = cli->line.size();
+                memcpy(cli->line, cli->prev_line, cli->prev_line_size);
+                cli->line_size = cli->prev_line_size;
+                cli->cursor_position = cli->line_size;
                 // Show new line to user
-                cli_write_str(cli, cli->line.c_str());
+                cli_write_data(cli, cli->line, cli->line_size);
             }
             cli->esc_mode = false;
             break;
@@ -127,7 +146,7 @@ static void cli_handle_char(Cli* cli, uint8_t c) {
             cli->esc_mode = false;
             break;
         case 'C': // Right
-            if(cli->cursor_position < cli->line.size()) {
+            if(cli->cursor_position < cli->line_size) {
                 cli_write_str(cli, "\e[C");
                 cli->cursor_position++;
             }
@@ -150,7 +169,7 @@ static void cli_handle_char(Cli* cli, uint8_t c) {
             cli->esc_mode = true;
             break;
         case CliSymbol::CR:
-            if(cli->line.size() == 0) {
+            if(cli->line_size == 0) {
                 cli_write_eol(cli);
             } else {
                 cli_write_eol(cli);
@@ -177,14 +196,22 @@ static void cli_handle_char(Cli* cli, uint8_t c) {
             cli_reset(cli);
             break;
         case ' ' ... '~':
-            if(cli->cursor_position == cli->line.size()) {
-                cli->line.push_back(c);
+            if(cli->line_size == CLI_LINE_SIZE) {
+                cli_write_char(cli, CliSymbol::Bell);
+            } else if(cli->cursor_position == cli->line_size) {
+                cli->line[cli->line_size++] = c;
                 cli_write_char(cli, c);
                 cli->cursor_position++;
             } else {
-                cli->line.insert(cli->cursor_position, 1, c);
+                memmove(
+                    &cli->line[cli->cursor_position + 1],
+                    &cli->line[cli->cursor_position],
+                    cli->line_size - cli->cursor_position);
+                cli->line[cli->cursor_position] = c;
+                cli->line_size++;
                 cli_write_str(cli, "\e[1@");
-                cli_write_str(cli, cli->line.substr(cli->cursor_position).c_str());
+                cli_write_data(
+                    cli, &cli->line[cli->cursor_position], cli->line_size - cli->cursor_position);
                 cli->cursor_position++;
                 cli_write_str(cli, "\e[D");
             }
@@ -193,20 +220,57 @@ static void cli_handle_char(Cli* cli, uint8_t c) {
             break;
         }
     }
+}
 
-    cli_flush(cli);
+// Hand the data to stdio only as fast as the CDC FIFO drains, so the task sleeps instead of
+// spinning in stdio while the host is slow
+static void cli_output_write(const char* data, size_t size) {
+    TickType_t stalled_since = xTaskGetTickCount();
+
+    while(size > 0 && tud_cdc_connected()) {
+        const size_t available = tud_cdc_write_available();
+        if(available == 0) {
+            if(xTaskGetTickCount() - stalled_since > pdMS_TO_TICKS(CLI_OUTPUT_TIMEOUT_MS)) {
+                break;
+            }
+            vTaskDelay(1);
+            continue;
+        }
+
+        const size_t chunk = std::min(size, available);
+        fwrite(data, 1, chunk, stdout);
+        fflush(stdout);
+        data += chunk;
+        size -= chunk;
+        stalled_since = xTaskGetTickCount();
+    }
+}
+
+static void cli_write_data(Cli* cli, const char* data, size_t size) {
+    while(size > 0) {
+        if(cli->output_size == CLI_OUTPUT_SIZE) {
+            cli_flush(cli);
+        }
+
+        const size_t chunk = std::min(size, CLI_OUTPUT_SIZE - cli->output_size);
+        memcpy(&cli->output[cli->output_size], data, chunk);
+        cli->output_size += chunk;
+        data += chunk;
+        size -= chunk;
+    }
 }
 
 void cli_write_prompt(Cli* cli) {
     cli_write_str(cli, ">: ");
+    cli_flush(cli);
 }
 
 void cli_write_str(Cli* cli, const char* str) {
-    fputs(str, stdout);
+    cli_write_data(cli, str, strlen(str));
 }
 
 void cli_write_char(Cli* cli, char c) {
-    putchar(c);
+    cli_write_data(cli, &c, 1);
 }
 
 void cli_write_eol(Cli* cli) {
@@ -214,44 +278,82 @@ void cli_write_eol(Cli* cli) {
 }
 
 void cli_flush(Cli* cli) {
-    fflush(stdout);
+    cli_output_write(cli->output, cli->output_size);
+    cli->output_size = 0;
 }
 
 void cli_printf(Cli* cli, const char* format, ...) {
     va_list args;
     va_start(args, format);
-    vprintf(format, args);
+
+    // Format in place, the buffer is flushed first only if the text doesn't fit
+    for(size_t attempt = 0; attempt < 2; attempt++) {
+        const size_t space = CLI_OUTPUT_SIZE - cli->output_size;
+        va_list copy;
+        va_copy(copy, args);
+        const int length = vsnprintf(&cli->output[cli->output_size], space, format, copy);
+        va_end(copy);
+
+        if(length < 0) {
+            break;
+        } else if((size_t)length < space) {
+            cli->output_size += length;
+            break;
+        } else if(cli->output_size > 0) {
+            cli_flush(cli);
+        } else {
+            // Longer than the whole buffer, send what fits
+            cli->output_size = CLI_OUTPUT_SIZE - 1;
+            break;
+        }
+    }
+
     va_end(args);
 }
 
-std::vector<std::string> cli_split_args(std::string& args) {
-    std::vector<std::string> argv;
-    std::string::size_type pos = 0;
-    std::string::size_type prev = 0;
-    while((pos = args.find_first_of(" ", prev)) != std::string::npos) {
-        if(pos > prev) {
-            argv.push_back(args.substr(prev, pos - prev));
+const CliArgs& cli_split_args(Cli* cli, std::string_view args) {
+    CliArgs& result = cli->args;
+    result.count = 0;
+    result.truncated = false;
+
+    size_t position = 0;
+    while(position < args.size()) {
+        const size_t end = std::min(args.find(' ', position), args.size());
+        if(end > position) {
+            if(result.count < CLI_ARGS_MAX) {
+                result.argv[result.count++] = args.substr(position, end - position);
+            } else {
+                result.truncated = true;
+            }
         }
-        prev = pos + 1;
-    }
-    if(prev < args.size()) {
-        argv.push_back(args.substr(prev));
+        position = end + 1;
     }
-    return argv;
+
+    return result;
 }
 
 extern "C" void cli_work(void) {
     Cli cli = {
-        .line = "",
-        .prev_line = "",
+        .line = {},
+        .line_size = 0,
+        .prev_line = {},
+        .prev_line_size = 0,
         .cursor_position = 0,
         .esc_mode = false,
+        .args = {},
+        .output = {},
+        .output_size = 0,
     };
 
     cli_force_motd(&cli);
 
     while(true) {
-        char c = getchar();
+        // Echoes of pasted or typed-ahead input go out together once it's all handled
+        int c = getchar_timeout_us(0);
+        if(c == PICO_ERROR_TIMEOUT) {
+            cli_flush(&cli);
+            c = getchar();
+        }
         cli_handle_char(&cli, c);
     }
 }
\ No newline at end of file
@@ -21,8 +21,31 @@ void cli_printf(Cli* cli, const char* format, ...);
 #endif
 
 #ifdef __cplusplus
-#include <string>
-#include <vector>
+#include <stddef.h>
+#include <string_view>
 
-std::vector<std::string> cli_split_args(std::string& args);
+#define CLI_ARGS_MAX 8
+
+// Views into the command line, valid until the command returns
+struct CliArgs {
+    std::string_view argv[CLI_ARGS_MAX];
+    size_t count;
+    bool truncated;
+
+    // Arguments that can be read, at most CLI_ARGS_MAX
+    size_t size() const {
+        return count;
+    }
+
+    // The line had more than CLI_ARGS_MAX arguments, the rest were dropped
+    bool overflowed() const {
+        return truncated;
+    }
+
+    const std::string_view& operator[](size_t index) const {
+        return argv[index];
+    }
+};
+
+const CliArgs& cli_split_args(Cli* cli, std::string_view args);
 #endif
\ No newline at end of file
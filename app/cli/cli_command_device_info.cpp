@@ -1,7 +1,7 @@
 #include "cli_commands.h"
 #include <pico/unique_id.h>
 
-void cli_device_info(Cli* cli, std::string& args) {
+void cli_device_info(Cli* cli, std::string_view args) {
     const size_t len = 2 * PICO_UNIQUE_BOARD_ID_SIZE_BYTES + 1;
     char id[len];
     pico_get_unique_board_id_string(id, len);
@@ -0,0 +1,76 @@
+#include "cli_commands.h"
+#include "../frame.h"
+
+// In FrameScale order
+static const char* const display_scale_names[FrameScaleCount] = {
+    "2x",
+    "4x",
+    "fill",
+};
+
+// In FrameOrientationSource order
+static const char* const display_orientation_source_names[FrameOrientationSourceCount] = {
+    "fixed",
+    "flipper",
+    "imu",
+};
+
+// In Orientation order
+static const char* const display_orientation_names[] = {
+    "horizontal",
+    "horizontal flip",
+    "vertical",
+    "vertical flip",
+};
+
+static void cli_display_help(Cli* cli) {
+    cli_printf(cli, "Usage: " EOL);
+    cli_printf(cli, "\tdisplay                    - show display settings" EOL);
+    cli_printf(cli, "\tdisplay scale <2x|4x|fill> - set picture scale" EOL);
+    cli_printf(cli, "\tdisplay raster <on|off>    - scrolling rainbow, one color per line" EOL);
+    cli_printf(cli, "\tdisplay orientation <fixed|flipper|imu>" EOL);
+    cli_printf(cli, "\t                           - orientation source" EOL);
+}
+
+void cli_display(Cli* cli, std::string_view args) {
+    const CliArgs& argv = cli_split_args(cli, args);
+
+    if(argv.size() == 0) {
+        cli_printf(cli, "scale: %s" EOL, display_scale_names[frame_get_scale()]);
+        cli_printf(cli, "raster: %s" EOL, frame_get_raster_enable() ? "on" : "off");
+        cli_printf(
+            cli,
+            "orientation: %s, %s" EOL,
+            display_orientation_source_names[frame_get_orientation_source()],
+            display_orientation_names[frame_get_orientation()]);
+        return;
+    }
+
+    if(argv.size() == 2 && argv[0] == "raster" && (argv[1] == "on" || argv[1] == "off")) {
+        frame_set_raster_enable(argv[1] == "on");
+        cli_printf(cli, "Raster set to: %s" EOL, frame_get_raster_enable() ? "on" : "off");
+        return;
+    }
+
+    if(argv.size() == 2 && argv[0] == "scale") {
+        for(size_t i = 0; i < FrameScaleCount; i++) {
+            if(argv[1] == display_scale_names[i]) {
+                frame_set_scale((FrameScale)i);
+                cli_printf(cli, "Scale set to: %s" EOL, display_scale_names[i]);
+                return;
+            }
+        }
+    }
+
+    if(argv.size() == 2 && argv[0] == "orientation") {
+        for(size_t i = 0; i < FrameOrientationSourceCount; i++) {
+            if(argv[1] == display_orientation_source_names[i]) {
+                frame_set_orientation_source((FrameOrientationSource)i);
+                cli_printf(cli, "Orientation set to: %s" EOL, display_orientation_source_names[i]);
+                return;
+            }
+        }
+    }
+
+    cli_display_help(cli);
+}
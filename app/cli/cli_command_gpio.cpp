@@ -1,6 +1,5 @@
 #include "cli_commands.h"
 #include "../led.h"
-#include <vector>
 #include <hardware/gpio.h>
 #include <FreeRTOS.h>
 #include <task.h>
@@ -31,7 +30,7 @@ static const GPIOItem gpios[] = {
 };
 
 typedef struct {
-    void (*const fn)(Cli* cli, std::vector<std::string>& argv);
+    void (*const fn)(Cli* cli, const CliArgs& argv);
     const char* name;
     const size_t argc;
 } CliGPIOCommand;
@@ -39,23 +38,32 @@ typedef struct {
 static const size_t gpios_count = sizeof(gpios) / sizeof(gpios[0]);
 static bool danger = false;
 
-static bool str_to_int(const char* str, uint8_t* value) {
-    char* end;
-    long int val = strtol(str, &end, 10);
-    if(val > UINT8_MAX || val < 0 || *end != '\0') {
+static bool str_to_int(std::string_view str, uint8_t* value) {
+    uint32_t val = 0;
+    if(str.empty()) {
         return false;
     }
 
+    for(char c : str) {
+        if(c < '0' || c > '9') {
+            return false;
+        }
+        val = val * 10 + (c - '0');
+        if(val > UINT8_MAX) {
+            return false;
+        }
+    }
+
     *value = (uint8_t)val;
     return true;
 }
 
-static const GPIOItem* gpio_get_and_prepare(Cli* cli, std::string& arg) {
+static const GPIOItem* gpio_get_and_prepare(Cli* cli, std::string_view arg) {
     const GPIOItem* gpio = NULL;
     uint8_t pin;
 
-    if(!str_to_int(arg.c_str(), &pin)) {
-        cli_printf(cli, "Invalid pin: %s" EOL, arg.c_str());
+    if(!str_to_int(arg, &pin)) {
+        cli_printf(cli, "Invalid pin: %.*s" EOL, (int)arg.size(), arg.data());
         return NULL;
     }
 
@@ -118,7 +126,7 @@ static void cli_gpio_help(Cli* cli) {
         "\tgpio i_know_what_i'm_doing - enable danger mode, may brick your device if you don't know what you're doing" EOL);
 }
 
-static void cli_gpio_list(Cli* cli, std::vector<std::string>& argv) {
+static void cli_gpio_list(Cli* cli, const CliArgs& argv) {
     cli_printf(cli, "GPIO pins:" EOL);
     for(size_t i = 0; i < gpios_count; i++) {
         const GPIOItem* gpio = &gpios[i];
@@ -137,16 +145,16 @@ static void cli_gpio_list(Cli* cli, std::vector<std::string>& argv) {
     return;
 }
 
-static void cli_gpio_out(Cli* cli, std::vector<std::string>& argv) {
+static void cli_gpio_out(Cli* cli, const CliArgs& argv) {
     uint8_t value;
-    if(!str_to_int(argv[2].c_str(), &value)) {
-        cli_printf(cli, "Invalid value: %s", argv[2].c_str());
+    if(!str_to_int(argv[2], &value)) {
+        cli_printf(cli, "Invalid value: %.*s", (int)argv[2].size(), argv[2].data());
         cli_write_eol(cli);
         return;
     }
 
     if(value != 0 && value != 1) {
-        cli_printf(cli, "Invalid value: %s", argv[2].c_str());
+        cli_printf(cli, "Invalid value: %.*s", (int)argv[2].size(), argv[2].data());
         cli_write_eol(cli);
         return;
     }
@@ -159,7 +167,7 @@ static void cli_gpio_out(Cli* cli, std::vector<std::string>& argv) {
     return;
 }
 
-static void cli_gpio_in(Cli* cli, std::vector<std::string>& argv) {
+static void cli_gpio_in(Cli* cli, const CliArgs& argv) {
     const GPIOItem* gpio = gpio_get_and_prepare(cli, argv[1]);
     if(gpio) {
         gpio_input(cli, gpio);
@@ -168,7 +176,7 @@ static void cli_gpio_in(Cli* cli, std::vector<std::string>& argv) {
     return;
 }
 
-static void cli_gpio_i_know(Cli* cli, std::vector<std::string>& argv) {
+static void cli_gpio_i_know(Cli* cli, const CliArgs& argv) {
     danger = true;
     cli_printf(
         cli, "Danger mode enabled. Boad may be bricked if you don't know what you're doing!");
@@ -186,8 +194,8 @@ static const CliGPIOCommand cli_gpio_commands[] = {
 static const size_t cli_gpio_commands_count =
     sizeof(cli_gpio_commands) / sizeof(cli_gpio_commands[0]);
 
-void cli_gpio(Cli* cli, std::string& args) {
-    std::vector<std::string> argv = cli_split_args(args);
+void cli_gpio(Cli* cli, std::string_view args) {
+    const CliArgs& argv = cli_split_args(cli, args);
     if(argv.size() < 1) {
         cli_gpio_help(cli);
         return;
@@ -2,6 +2,8 @@
 #include "../led.h"
 // #include "../imu/imu_reg.hpp"
 #include "../imu/ICM42688P_regs.h"
+#include "../imu/imu.h"
+#include "../imu/fusion.h"
 #include <vector>
 #include <hardware/gpio.h>
 #include "hardware/resets.h"
@@ -101,34 +103,36 @@ typedef enum {
     GyroFullScaleTotal,
 } ICM42688PGyroFullScale;
 
+// Full scale in mg, no floats on a core without an FPU
 static const struct AccelFullScale {
-    float value;
+    uint32_t value;
     uint8_t reg_mask;
 } accel_fs_modes[] = {
-    [AccelFullScale16G] = {16.f, ICM42688_AFS_16G},
-    [AccelFullScale8G] = {8.f, ICM42688_AFS_8G},
-    [AccelFullScale4G] = {4.f, ICM42688_AFS_4G},
-    [AccelFullScale2G] = {2.f, ICM42688_AFS_2G},
+    [AccelFullScale16G] = {16000, ICM42688_AFS_16G},
+    [AccelFullScale8G] = {8000, ICM42688_AFS_8G},
+    [AccelFullScale4G] = {4000, ICM42688_AFS_4G},
+    [AccelFullScale2G] = {2000, ICM42688_AFS_2G},
 };
 
+// Full scale in mdps
 static const struct GyroFullScale {
-    float value;
+    uint32_t value;
     uint8_t reg_mask;
 } gyro_fs_modes[] = {
-    [GyroFullScale2000DPS] = {2000.f, ICM42688_GFS_2000DPS},
-    [GyroFullScale1000DPS] = {1000.f, ICM42688_GFS_1000DPS},
-    [GyroFullScale500DPS] = {500.f, ICM42688_GFS_500DPS},
-    [GyroFullScale250DPS] = {250.f, ICM42688_GFS_250DPS},
-    [GyroFullScale125DPS] = {125.f, ICM42688_GFS_125DPS},
-    [GyroFullScale62_5DPS] = {62.5f, ICM42688_GFS_62_5DPS},
-    [GyroFullScale31_25DPS] = {31.25f, ICM42688_GFS_31_25DPS},
-    [GyroFullScale15_625DPS] = {15.625f, ICM42688_GFS_15_625DPS},
+    [GyroFullScale2000DPS] = {2000000, ICM42688_GFS_2000DPS},
+    [GyroFullScale1000DPS] = {1000000, ICM42688_GFS_1000DPS},
+    [GyroFullScale500DPS] = {500000, ICM42688_GFS_500DPS},
+    [GyroFullScale250DPS] = {250000, ICM42688_GFS_250DPS},
+    [GyroFullScale125DPS] = {125000, ICM42688_GFS_125DPS},
+    [GyroFullScale62_5DPS] = {62500, ICM42688_GFS_62_5DPS},
+    [GyroFullScale31_25DPS] = {31250, ICM42688_GFS_31_25DPS},
+    [GyroFullScale15_625DPS] = {15625, ICM42688_GFS_15_625DPS},
 };
 
 struct ICM42688P {
     SPIBus bus;
-    float accel_scale;
-    float gyro_scale;
+    uint32_t accel_scale;
+    uint32_t gyro_scale;
 };
 
 static bool icm42688p_accel_config(
@@ -217,12 +221,26 @@ static void read_awg_accel(ICM42688P& imu, int32_t* data) {
     data[2] /= sample_cnt;
 }
 
-#define INV_ST_OTP_EQUATION(FS, ST_code) \
-    (uint32_t)((2620.f / powf(2.f, 3.f - FS)) * powf(1.01f, ST_code - 1.f) + 0.5f)
+/* (2620 / 2^(3 - FS)) * 1.01^(ST_code - 1), rounded, in 40.24 fixed point */
+static uint32_t inv_st_otp(uint8_t fs, uint8_t st_code) {
+    uint64_t value = (uint64_t)2620 << 24;
+    for(uint8_t i = 1; i < st_code; i++) {
+        value += value / 100;
+    }
+    value >>= (3 - fs);
+    return (uint32_t)((value + (1 << 23)) >> 24);
+}
 
 /* Pass/Fail criteria */
-#define MIN_RATIO 0.5f /* expected ratio greater than 0.5 */
-#define MAX_RATIO 1.5f /* expected ratio lower than 1.5 */
+#define MIN_RATIO_PERCENT 50 /* expected ratio greater than 0.5 */
+#define MAX_RATIO_PERCENT 150 /* expected ratio lower than 1.5 */
+
+/* response / otp outside of the ratio limits, in integers */
+static bool selftest_ratio_fails(uint32_t response, uint32_t otp) {
+    const uint64_t scaled = (uint64_t)response * 100;
+    return (scaled >= (uint64_t)otp * MAX_RATIO_PERCENT) ||
+           (scaled <= (uint64_t)otp * MIN_RATIO_PERCENT);
+}
 
 #define MIN_ST_GYRO_DPS 60 /* expected values greater than 60dps */
 #define MAX_ST_GYRO_OFFSET_DPS 20 /* expected offset less than 20 dps */
@@ -274,13 +292,12 @@ static bool run_gyro_self_test(ICM42688P& imu, int32_t* st_bias, Cli* cli) {
     } else { /* If ST_DATA != 0 for all axis */
         /* compare the Self-Test response to the factory OTP values */
         for(uint8_t i = 0; i < 3; i++) {
-            selftest_otp[i] = INV_ST_OTP_EQUATION(GyroFullScale250DPS, selftest_data[i]);
+            selftest_otp[i] = inv_st_otp(GyroFullScale250DPS, selftest_data[i]);
             if(selftest_otp[i] == 0) {
                 cli_printf(cli, "Gyro selftest error: otp 0" EOL);
                 result = false;
             } else {
-                float ratio = ((float)selftest_response[i]) / ((float)selftest_otp[i]);
-                if((ratio >= MAX_RATIO) || (ratio <= MIN_RATIO)) {
+                if(selftest_ratio_fails(selftest_response[i], selftest_otp[i])) {
                     cli_printf(cli, "Gyro selftest error: otp ratio" EOL);
                     result = false;
                 }
@@ -349,13 +366,12 @@ static bool run_accel_self_test(ICM42688P& imu, int32_t* st_bias, Cli* cli) {
     } else { /* If ST_DATA != 0 for all axis */
         /* compare the Self-Test response to the factory OTP values */
         for(uint8_t i = 0; i < 3; i++) {
-            selftest_otp[i] = INV_ST_OTP_EQUATION(AccelFullScale2G, selftest_data[i]);
+            selftest_otp[i] = inv_st_otp(AccelFullScale2G, selftest_data[i]);
             if(selftest_otp[i] == 0) {
                 cli_printf(cli, "Accel selftest error: otp 0" EOL);
                 result = false;
             } else {
-                float ratio = ((float)selftest_response[i]) / ((float)selftest_otp[i]);
-                if((ratio >= MAX_RATIO) || (ratio <= MIN_RATIO)) {
+                if(selftest_ratio_fails(selftest_response[i], selftest_otp[i])) {
                     cli_printf(cli, "Accel selftest error: otp ratio" EOL);
                     result = false;
                 }
@@ -457,7 +473,12 @@ static void spi_deinit(SPIBus& bus) {
     gpio_set_dir(bus.gp_cs, GPIO_IN);
 }
 
-void cli_imu_test(Cli* cli, std::string& args) {
+void cli_imu_test(Cli* cli, std::string_view args) {
+    if(imu_get_state() == ImuStateRunning) {
+        cli_printf(cli, "IMU is streaming, stop it with \"imu rate off\" first" EOL);
+        return;
+    }
+
     // reg_read(spi, cs_pin, REG_DEVID, data, 1);
 
     const uint8_t cs_pin = 5;
@@ -529,4 +550,122 @@ void cli_imu_test(Cli* cli, std::string& args) {
     } while(false);
 
     spi_deinit(imu.bus);
-}
\ No newline at end of file
+}
+
+// In ImuRate order
+static const char* const imu_rate_names[ImuRateCount] = {
+    "off",
+    "1k",
+    "2k",
+    "4k",
+    "8k",
+};
+
+// In ImuState order
+static const char* const imu_state_names[] = {
+    "stopped",
+    "running",
+    "no device",
+};
+
+static void cli_imu_help(Cli* cli) {
+    cli_printf(cli, "Usage: " EOL);
+    cli_printf(cli, "\timu                        - show IMU state and orientation" EOL);
+    cli_printf(cli, "\timu rate <off|1k|2k|4k|8k> - set sample rate" EOL);
+    cli_printf(cli, "\timu stream <count>         - print samples: ax ay az gx gy gz t_us" EOL);
+}
+
+static int32_t cli_imu_q30_milli(int32_t value) {
+    return (int32_t)(((int64_t)value * 1000) >> 30);
+}
+
+static void cli_imu_stream(Cli* cli, uint32_t count) {
+    imu_reader_t reader;
+    imu_reader_init(&reader);
+
+    // Give up after 10 ms without samples, ten sample periods at the lowest rate
+    uint32_t idle_ms = 0;
+
+    while(count > 0 && idle_ms < 10) {
+        imu_sample_t samples[16];
+        const size_t size = imu_read(&reader, samples, MIN(count, count_of(samples)));
+        if(size == 0) {
+            vTaskDelay(1);
+            idle_ms++;
+            continue;
+        }
+
+        idle_ms = 0;
+        for(size_t i = 0; i < size; i++) {
+            const imu_sample_t* sample = &samples[i];
+            cli_printf(
+                cli,
+                "%d %d %d %d %d %d %u" EOL,
+                sample->accel[0],
+                sample->accel[1],
+                sample->accel[2],
+                sample->gyro[0],
+                sample->gyro[1],
+                sample->gyro[2],
+                sample->timestamp_us);
+        }
+        count -= size;
+    }
+
+    cli_printf(cli, "lost: %lu" EOL, reader.lost);
+}
+
+void cli_imu(Cli* cli, std::string_view args) {
+    const CliArgs& argv = cli_split_args(cli, args);
+
+    if(argv.size() == 0) {
+        const ImuRate rate = imu_get_rate();
+        cli_printf(cli, "state: %s" EOL, imu_state_names[imu_get_state()]);
+        cli_printf(cli, "rate: %lu Hz" EOL, imu_get_rate_hz(rate));
+
+        fusion_output_t output;
+        fusion_get_output(&output);
+        cli_printf(
+            cli,
+            "quaternion: %ld %ld %ld %ld (x1000)" EOL,
+            cli_imu_q30_milli(output.quaternion[0]),
+            cli_imu_q30_milli(output.quaternion[1]),
+            cli_imu_q30_milli(output.quaternion[2]),
+            cli_imu_q30_milli(output.quaternion[3]));
+        cli_printf(
+            cli,
+            "gravity: %ld %ld %ld (mg)" EOL,
+            cli_imu_q30_milli(output.gravity[0]),
+            cli_imu_q30_milli(output.gravity[1]),
+            cli_imu_q30_milli(output.gravity[2]));
+        return;
+    }
+
+    if(argv.size() == 2 && argv[0] == "rate") {
+        for(size_t i = 0; i < ImuRateCount; i++) {
+            if(argv[1] == imu_rate_names[i]) {
+                imu_set_rate((ImuRate)i);
+                cli_printf(cli, "Rate set to: %s" EOL, imu_rate_names[i]);
+                return;
+            }
+        }
+    }
+
+    if(argv.size() == 2 && argv[0] == "stream") {
+        uint32_t count = 0;
+        for(char c : argv[1]) {
+            if(c < '0' || c > '9' || count > UINT32_MAX / 10) {
+                count = 0;
+                break;
+            }
+            count = count * 10 + (c - '0');
+        }
+
+        if(count > 0) {
+            cli_imu_stream(cli, count);
+            return;
+        }
+    }
+
+    cli_imu_help(cli);
+}
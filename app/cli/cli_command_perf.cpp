@@ -0,0 +1,121 @@
+#include "cli_commands.h"
+#include "../perf.h"
+#include <pico/time.h>
+
+typedef struct {
+    perf_snapshot_t snapshot;
+    uint64_t time_us;
+} PerfBaseline;
+
+static PerfBaseline baseline = {};
+
+// In PerfCounter order
+static const char* const perf_counter_names[PerfCounterCount] = {
+    "frames_received",
+    "frames_skipped",
+    "frames_superseded",
+    "checksum_errors",
+    "heartbeats",
+    "link_resyncs",
+    "stream_restarts",
+    "handshakes",
+    "scanline_overruns",
+    "scanline_pool_empty",
+};
+
+// In PerfHistogram order
+static const char* const perf_histogram_names[PerfHistogramCount] = {
+    "receive_us",
+    "publish_us",
+    "display_us",
+    "recovery_us",
+};
+
+// Upper bound of the bucket, in us
+static uint32_t perf_bucket_limit(size_t bucket) {
+    return 1UL << bucket;
+}
+
+static size_t perf_percentile(const uint32_t* buckets, uint32_t count, uint32_t percent) {
+    const uint64_t target = ((uint64_t)count * percent + 99) / 100;
+    uint64_t sum = 0;
+
+    for(size_t bucket = 0; bucket < PERF_HISTOGRAM_BUCKETS; bucket++) {
+        sum += buckets[bucket];
+        if(sum >= target) {
+            return bucket;
+        }
+    }
+
+    return PERF_HISTOGRAM_BUCKETS - 1;
+}
+
+static void cli_perf_histogram(Cli* cli, const char* name, const uint32_t* buckets) {
+    uint32_t count = 0;
+    for(size_t bucket = 0; bucket < PERF_HISTOGRAM_BUCKETS; bucket++) {
+        count += buckets[bucket];
+    }
+
+    cli_printf(cli, "%s: count %lu", name, count);
+    if(count > 0) {
+        const size_t p50 = perf_percentile(buckets, count, 50);
+        const size_t p99 = perf_percentile(buckets, count, 99);
+        cli_printf(cli, ", p50 < %lu, p99 < %lu", perf_bucket_limit(p50), perf_bucket_limit(p99));
+    }
+    cli_write_eol(cli);
+
+    for(size_t bucket = 0; bucket < PERF_HISTOGRAM_BUCKETS; bucket++) {
+        if(buckets[bucket] == 0) continue;
+
+        if(bucket == PERF_HISTOGRAM_BUCKETS - 1) {
+            cli_printf(cli, "  >= %7lu: %lu" EOL, perf_bucket_limit(bucket - 1), buckets[bucket]);
+        } else {
+            cli_printf(cli, "  < %8lu: %lu" EOL, perf_bucket_limit(bucket), buckets[bucket]);
+        }
+    }
+}
+
+static void cli_perf_show(Cli* cli) {
+    perf_snapshot_t snapshot;
+    perf_get_snapshot(&snapshot);
+
+    const uint64_t elapsed_us = time_us_64() - baseline.time_us;
+    cli_printf(cli, "elapsed_ms: %lu" EOL, (uint32_t)(elapsed_us / 1000));
+
+    for(size_t i = 0; i < PerfCounterCount; i++) {
+        const uint32_t value = snapshot.counters[i] - baseline.snapshot.counters[i];
+        cli_printf(cli, "%s: %lu", perf_counter_names[i], value);
+
+        if(i == PerfCounterFramesReceived && elapsed_us > 0) {
+            const uint32_t fps_x10 = (uint32_t)((uint64_t)value * 10000000ULL / elapsed_us);
+            cli_printf(cli, " (%lu.%lu fps)", fps_x10 / 10, fps_x10 % 10);
+        }
+        cli_write_eol(cli);
+    }
+
+    for(size_t i = 0; i < PerfHistogramCount; i++) {
+        uint32_t buckets[PERF_HISTOGRAM_BUCKETS];
+        for(size_t bucket = 0; bucket < PERF_HISTOGRAM_BUCKETS; bucket++) {
+            buckets[bucket] =
+                snapshot.histograms[i][bucket] - baseline.snapshot.histograms[i][bucket];
+        }
+        cli_perf_histogram(cli, perf_histogram_names[i], buckets);
+    }
+}
+
+static void cli_perf_reset(Cli* cli) {
+    // The writers are never stopped, so a reset only moves the baseline
+    perf_get_snapshot(&baseline.snapshot);
+    baseline.time_us = time_us_64();
+    cli_printf(cli, "Statistics reset" EOL);
+}
+
+void cli_perf(Cli* cli, std::string_view args) {
+    if(args.empty()) {
+        cli_perf_show(cli);
+    } else if(args == "reset") {
+        cli_perf_reset(cli);
+    } else {
+        cli_printf(cli, "Usage: perf [reset]" EOL);
+    }
+}
@@ -0,0 +1,40 @@
+#include "cli_commands.h"
+#include "../frame.h"
+
+static void cli_scanline_stats_show(Cli* cli) {
+    frame_scanline_stats_t stats;
+
+    if(!frame_get_scanline_stats(&stats)) {
+        cli_printf(cli, "No statistics, build with -DFRAME_SCANLINE_PROFILE=ON" EOL);
+        return;
+    }
+
+    if(stats.lines == 0) {
+        cli_printf(cli, "No scanlines since the reset" EOL);
+        return;
+    }
+
+    const uint32_t average = (uint32_t)(stats.total_cycles / stats.lines);
+    cli_printf(cli, "lines: %lu" EOL, stats.lines);
+    cli_printf(cli, "budget_cycles: %lu" EOL, stats.budget_cycles);
+    cli_printf(
+        cli,
+        "cycles: min %lu, avg %lu, max %lu (%lu%% of budget)" EOL,
+        stats.min_cycles,
+        average,
+        stats.max_cycles,
+        stats.max_cycles * 100 / stats.budget_cycles);
+    cli_printf(cli, "over_budget: %lu" EOL, stats.over_budget);
+    cli_printf(cli, "worst_scanline: %lu" EOL, stats.worst_scanline);
+}
+
+void cli_scanline_stats(Cli* cli, std::string_view args) {
+    if(args.empty()) {
+        cli_scanline_stats_show(cli);
+    } else if(args == "reset") {
+        frame_reset_scanline_stats();
+        cli_printf(cli, "Statistics reset" EOL);
+    } else {
+        cli_printf(cli, "Usage: scanline_stats [reset]" EOL);
+    }
+}
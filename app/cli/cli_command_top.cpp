@@ -0,0 +1,105 @@
+#include "cli_commands.h"
+#include "../instrumentation.h"
+#include <FreeRTOS.h>
+#include <task.h>
+#include <pico/time.h>
+
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+#define TOP_TASKS_MAX 16
+
+typedef struct {
+    UBaseType_t number;
+    uint32_t run_time;
+} TopTaskTime;
+
+// Run time at the previous "top", so the CPU load is the one since then
+static TopTaskTime previous[TOP_TASKS_MAX];
+static size_t previous_count = 0;
+static uint32_t previous_total = 0;
+
+static char top_state_char(eTaskState state) {
+    switch(state) {
+    case eRunning:
+        return 'X';
+    case eReady:
+        return 'R';
+    case eBlocked:
+        return 'B';
+    case eSuspended:
+        return 'S';
+    case eDeleted:
+        return 'D';
+    default:
+        return '?';
+    }
+}
+
+static uint32_t top_previous_run_time(UBaseType_t number) {
+    for(size_t i = 0; i < previous_count; i++) {
+        if(previous[i].number == number) {
+            return previous[i].run_time;
+        }
+    }
+    return 0;
+}
+
+static void cli_top_tasks(Cli* cli) {
+    static TaskStatus_t tasks[TOP_TASKS_MAX];
+    uint32_t total;
+
+    const UBaseType_t count = uxTaskGetSystemState(tasks, TOP_TASKS_MAX, &total);
+    if(count == 0) {
+        cli_printf(cli, "More than %u tasks" EOL, TOP_TASKS_MAX);
+        return;
+    }
+
+    // Each counter wraps on its own after 71 minutes, the unsigned differences stay right
+    const uint32_t elapsed = total - previous_total;
+    cli_printf(cli, "cpu over the last %lu ms" EOL, elapsed / 1000);
+    cli_printf(cli, "%-16s state prio   cpu stack_free" EOL, "task");
+
+    for(UBaseType_t i = 0; i < count; i++) {
+        const TaskStatus_t* task = &tasks[i];
+        const uint32_t run_time =
+            task->ulRunTimeCounter - top_previous_run_time(task->xTaskNumber);
+        const uint32_t permille = elapsed ? (uint32_t)((uint64_t)run_time * 1000 / elapsed) : 0;
+
+        cli_printf(
+            cli,
+            "%-16s %c     %4lu %3lu.%lu%% %10u" EOL,
+            task->pcTaskName,
+            top_state_char(task->eCurrentState),
+            (uint32_t)task->uxCurrentPriority,
+            permille / 10,
+            permille % 10,
+            (unsigned)task->usStackHighWaterMark);
+    }
+
+    for(UBaseType_t i = 0; i < count; i++) {
+        previous[i].number = tasks[i].xTaskNumber;
+        previous[i].run_time = tasks[i].ulRunTimeCounter;
+    }
+    previous_count = count;
+    previous_total = total;
+}
+#endif
+
+void cli_top(Cli* cli, std::string_view args) {
+    instrumentation_heap_t heap;
+    instrumentation_get_heap(&heap);
+
+    cli_printf(cli, "uptime_ms: %lu" EOL, (uint32_t)(time_us_64() / 1000));
+    cli_printf(
+        cli,
+        "heap: total %u, used %u, free %u, min_free %u" EOL,
+        heap.total,
+        heap.used,
+        heap.free,
+        heap.min_free);
+
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+    cli_top_tasks(cli);
+#else
+    cli_printf(cli, "No task statistics, build with -DVGM_INSTRUMENTATION=ON" EOL);
+#endif
+}
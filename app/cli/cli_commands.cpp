@@ -1,11 +1,16 @@
 #include "cli_commands.h"
 #include <string.h>
 
-void cli_gpio(Cli* cli, std::string& args);
-void cli_device_info(Cli* cli, std::string& args);
-void cli_imu_test(Cli* cli, std::string& args);
+void cli_gpio(Cli* cli, std::string_view args);
+void cli_device_info(Cli* cli, std::string_view args);
+void cli_imu_test(Cli* cli, std::string_view args);
+void cli_imu(Cli* cli, std::string_view args);
+void cli_perf(Cli* cli, std::string_view args);
+void cli_display(Cli* cli, std::string_view args);
+void cli_scanline_stats(Cli* cli, std::string_view args);
+void cli_top(Cli* cli, std::string_view args);
 
-void cli_help(Cli* cli, std::string& args) {
+void cli_help(Cli* cli, std::string_view args) {
     size_t max_len = 0;
     for(size_t i = 0; i < cli_items_count; i++) {
         if(strlen(cli_items[i].name) > max_len) {
@@ -34,7 +39,8 @@ void cli_help(Cli* cli, std::string& args) {
     cli_write_eol(cli);
 }
 
-const CliItem cli_items[] = {
+// Sorted by name, commands are looked up with a binary search
+constexpr CliItem cli_items[] = {
     {
         .name = "!",
         .desc = "alias for device_info",
@@ -45,26 +51,62 @@ const CliItem cli_items[] = {
         .desc = "alias for help",
         .callback = cli_help,
     },
-    {
-        .name = "help",
-        .desc = "show this help",
-        .callback = cli_help,
-    },
     {
         .name = "device_info",
         .desc = "show device info",
         .callback = cli_device_info,
     },
+    {
+        .name = "display",
+        .desc = "display settings",
+        .callback = cli_display,
+    },
     {
         .name = "gpio",
         .desc = "gpio control",
         .callback = cli_gpio,
     },
+    {
+        .name = "help",
+        .desc = "show this help",
+        .callback = cli_help,
+    },
+    {
+        .name = "imu",
+        .desc = "IMU sample stream",
+        .callback = cli_imu,
+    },
     {
         .name = "imu_test",
         .desc = "test the IMU",
         .callback = cli_imu_test,
     },
+    {
+        .name = "perf",
+        .desc = "frame pipeline statistics, \"perf reset\" to restart",
+        .callback = cli_perf,
+    },
+    {
+        .name = "scanline_stats",
+        .desc = "core1 cycles per scanline, \"scanline_stats reset\" to restart",
+        .callback = cli_scanline_stats,
+    },
+    {
+        .name = "top",
+        .desc = "task CPU load and stack use since the last call, heap use",
+        .callback = cli_top,
+    },
 };
 
-size_t cli_items_count = sizeof(cli_items) / sizeof(CliItem);
\ No newline at end of file
+const size_t cli_items_count = sizeof(cli_items) / sizeof(CliItem);
+
+static constexpr bool cli_items_sorted() {
+    for(size_t i = 1; i < sizeof(cli_items) / sizeof(CliItem); i++) {
+        if(std::string_view(cli_items[i - 1].name) >= std::string_view(cli_items[i].name)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(cli_items_sorted(), "cli_items must be sorted by name");
\ No newline at end of file
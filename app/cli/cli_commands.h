@@ -1,8 +1,8 @@
 #pragma once
-#include <string>
+#include <string_view>
 #include "cli.h"
 
-typedef void (*CliCallback)(Cli* cli, std::string& args);
+typedef void (*CliCallback)(Cli* cli, std::string_view args);
 
 struct CliItem {
     const char* name;
@@ -10,5 +10,6 @@ struct CliItem {
     CliCallback callback;
 };
 
+// Sorted by name
 extern const CliItem cli_items[];
-extern size_t cli_items_count;
\ No newline at end of file
+extern const size_t cli_items_count;
\ No newline at end of file
@@ -39,6 +39,13 @@ extern "C" {
  */
 #define EXPANSION_PROTOCOL_BAUD_CHANGE_DT_MS (25U)
 
+/**
+ * @brief Maximum number of unacknowledged data frames in windowed mode.
+ *
+ * @see ExpansionFrameControlCommandStartRpcWindowed.
+ */
+#define EXPANSION_PROTOCOL_WINDOW_SIZE (8U)
+
 /**
  * @brief Enumeration of supported frame types.
  */
@@ -62,10 +69,26 @@ typedef enum {
 
 /**
  * @brief Enumeration of suported control commands.
+ *
+ * In a session started with ExpansionFrameControlCommandStartRpc every data frame is
+ * confirmed with a status frame before the next one is sent.
+ *
+ * In a session started with ExpansionFrameControlCommandStartRpcWindowed the sender may
+ * have up to EXPANSION_PROTOCOL_WINDOW_SIZE data frames unconfirmed. The receiver sends
+ * one (cumulative) status frame for every EXPANSION_PROTOCOL_WINDOW_SIZE data frames, and
+ * one for the remaining data frames as soon as it has received a complete RPC message.
+ * A side not supporting windowed mode responds with ExpansionFrameErrorUnknown, and the
+ * module falls back to ExpansionFrameControlCommandStartRpc.
+ *
+ * ExpansionFrameControlCommandEnableScreenCodec is sent in an open RPC session before the
+ * screen stream is started. On success the host may send screen frames in a compact format,
+ * otherwise only raw frames are sent.
  */
 typedef enum {
     ExpansionFrameControlCommandStartRpc = 0x00, /**< Start an RPC session. */
     ExpansionFrameControlCommandStopRpc = 0x01, /**< Stop an open RPC session. */
+    ExpansionFrameControlCommandStartRpcWindowed = 0x02, /**< Start a windowed RPC session. */
+    ExpansionFrameControlCommandEnableScreenCodec = 0x03, /**< Allow compact screen frames. */
 } ExpansionFrameControlCommand;
 
 #pragma pack(push, 1)
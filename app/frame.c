@@ -3,15 +3,52 @@
 #include <common_dvi_pin_configs.h>
 #include <sprite.h>
 #include <pico/multicore.h>
+#include <hardware/sync.h>
+#include <hardware/irq.h>
 #include <hardware/vreg.h>
+#include <hardware/timer.h>
+#include <hardware/gpio.h>
+#include <hardware/structs/systick.h>
 #include <string.h>
 #include "frame.h"
+#include "frame_kernels.h"
+#include "perf.h"
 
 #define FRAME_WIDTH 320
 #define FRAME_HEIGHT 240
 
 static struct dvi_inst dvi0;
-static uint16_t framebuf[FRAME_WIDTH * 2];
+
+// Scanlines queued ahead of the TMDS encoder. The libdvi colour queues hold 8 entries.
+#ifndef FRAME_SCANLINE_DEPTH
+#define FRAME_SCANLINE_DEPTH 4
+#endif
+
+_Static_assert(
+    FRAME_SCANLINE_DEPTH >= 2 && FRAME_SCANLINE_DEPTH <= 8,
+    "FRAME_SCANLINE_DEPTH must be 2 to 8");
+
+// Small buffers touched on every scanline live in the scratch banks, away from core0's
+// protobuf and RX data in the striped main SRAM. SCRATCH_X also holds the core1 stack,
+// SCRATCH_Y the core0 interrupt stack, leaving about 2 KB free in each.
+//
+// Lines of the pool that fit in that space next to the core1 stack, 640 bytes each. Deeper
+// pools (1.9 to 5 KB) don't fit and go to main SRAM, where DMA reads of the vertical and
+// raster lines share banks with core0 again.
+#define FRAME_SCANLINE_SCRATCH_DEPTH 2
+
+#if FRAME_SCANLINE_DEPTH <= FRAME_SCANLINE_SCRATCH_DEPTH
+#define FRAME_SCANLINE_POOL_SECTION __scratch_x("scanline_pool")
+#else
+#define FRAME_SCANLINE_POOL_SECTION
+#endif
+
+// Buffers for lines rendered one at a time. Only buffers the encoder has handed back through
+// q_colour_free are rendered into, so a line is never rewritten while it's still queued.
+static uint16_t FRAME_SCANLINE_POOL_SECTION __aligned(4)
+    scanline_pool[FRAME_SCANLINE_DEPTH][FRAME_WIDTH];
+static uint16_t* scanline_free[FRAME_SCANLINE_DEPTH];
+static uint scanline_free_count = 0;
 
 #define COLOR_BG 0xFC00
 #define COLOR_FG 0x0000
@@ -20,116 +57,517 @@ static uint16_t framebuf[FRAME_WIDTH * 2];
 #define COLOR_GREEN 0x07E0
 #define COLOR_BLUE 0x001F
 
-bool orientation_enable = false;
-uint16_t color_bg = COLOR_BG;
-uint16_t color_fg = COLOR_FG;
+// Requested colors, background in the low half. A single word, so core1 never sees a
+// background from one request with the foreground of another.
+static volatile uint32_t palette_requested = COLOR_BG | ((uint32_t)COLOR_FG << 16);
 
 // TMDS bit clock 252 MHz
 // DVDD 1.2V (1.1V seems ok too)
 #define VREG_VSEL VREG_VOLTAGE_1_20
 #define DVI_TIMING dvi_timing_640x480p_60hz
 
+// One bit per 8-row page of the Flipper frame
+#define FRAME_PAGES (FLIPPER_HEIGHT / 8)
+#define FRAME_PAGE_SIZE (sizeof(frame_t) / FRAME_PAGES)
+#define FRAME_PAGES_ALL ((1u << FRAME_PAGES) - 1)
+
 typedef struct {
     frame_t frame;
     uint8_t orientation;
+    // Pages that differ from the frame core1 showed before this one
+    uint8_t dirty;
+    // time_us_32() at publish, the low word is enough for the latency and is cheap on core1
+    uint32_t published_us;
 } frame_data_t;
 
-static frame_data_t current = {0};
-static frame_data_t next = {0};
-auto_init_mutex(data_mutex);
+// Triple buffer between the producer (uart_task) and core1. Core1 shows frames[front], the
+// producer fills frames[back] and frame_ready holds the latest published frame. Only the
+// index exchange is shared, so neither side ever copies a frame or waits for the other.
+#define FRAME_READY_FRESH 0x80
+
+static frame_data_t frames[3] = {0};
+static volatile uint8_t frame_ready = 1;
+static uint8_t frame_front = 0;
+static uint8_t frame_back = 2;
+// Last published frame, only used by the producer to find the dirty pages
+static uint8_t frame_last = 1;
+static spin_lock_t* frame_lock;
+
+static const frame_data_t* current = &frames[0];
+
+// Frames started since boot, written by core1 at scanline 0 and passed to core0 through the
+// SIO FIFO, which is free once core1 runs
+static volatile uint32_t frame_count = 0;
+static FrameVsyncCallback vsync_callback = NULL;
+static void* vsync_context = NULL;
+
+// Flipper picture geometry inside the scanline buffer
+#define FLIPPER_WIDTH FRAME_KERNEL_WIDTH
+#define FLIPPER_HEIGHT FRAME_KERNEL_HEIGHT
+
+// Horizontal picture scale, in scanline buffer pixels (DVI doubles them once more)
+typedef struct {
+    uint8_t columns; // Buffer pixels per Flipper pixel, 1 or 2
+    uint8_t rows; // Scanlines per Flipper row
+} frame_scale_t;
+
+static const frame_scale_t frame_scales[FrameScaleCount] = {
+    [FrameScale2x] = {.columns = 1, .rows = 1},
+    [FrameScale4x] = {.columns = 2, .rows = 2},
+    [FrameScaleFill] = {.columns = 2, .rows = 3},
+};
+
+static volatile uint8_t scale_requested = FrameScaleFill;
+
+static volatile uint8_t orientation_source = FrameOrientationSourceFixed;
+static volatile uint8_t orientation_requested = OrientationHorizontal;
+
+// Layout latched at the start of the frame: the picture is centered, the rest is letterboxed.
+// Vertical orientations show one Flipper column per scanline and are never scaled.
+static uint8_t frame_scale = FrameScaleFill;
+static uint8_t frame_orientation = OrientationHorizontal;
+static uint16_t picture_left;
+static uint16_t picture_right;
+// Picture row shown on every scanline, -1 for blank lines. Rows count in display order, so a
+// vertical picture has FLIPPER_WIDTH of them.
+static int8_t row_map[FRAME_HEIGHT];
+
+// Vertical lines are cheap to expand but too many to cache, so they're rendered into the pool.
+// A pool buffer keeps the borders it was filled with, tagged with the epoch of the palette and
+// layout they were drawn for, and only the picture is rewritten while the tag matches.
+static uint32_t scanline_border[FRAME_SCANLINE_DEPTH];
+static uint32_t border_epoch = 1;
+
+// Every Flipper row is shown on several consecutive scanlines, so each row is expanded once
+// per frame into a complete scanline and the same buffer is queued repeatedly. The borders of
+// a cached row only change with the palette or the layout, the picture with the frame.
+static uint16_t __aligned(4) row_cache[FLIPPER_HEIGHT][FRAME_WIDTH];
+static uint32_t row_cache_valid[FLIPPER_HEIGHT / 32];
+static uint32_t row_border_valid[FLIPPER_HEIGHT / 32];
+// Lines above and below the picture. Two copies, so a palette change never rewrites a line
+// that may still be queued for the encoder from the end of the previous frame. 1280 bytes,
+// most of what SCRATCH_Y has left.
+static uint16_t __scratch_y("blank_line") __aligned(4) blank_line[2][FRAME_WIDTH];
+static uint8_t blank_line_index = 0;
+
+// Colors latched at the start of the frame
+static uint16_t frame_bg = COLOR_BG;
+static uint16_t frame_fg = COLOR_FG;
+
+// Raster effect: every scanline takes its background from the palette, starting at the phase.
+// Two palettes, so a new one is never written while core1 shows the other.
+static uint16_t raster_palettes[2][FRAME_RASTER_PALETTE_MAX];
+// Palette number in bit 16, entry count below
+static volatile uint32_t raster_requested = 0;
+static volatile uint32_t raster_phase_requested = 0;
+static volatile bool raster_enabled = false;
+static uint8_t raster_write_index = 0;
+
+// Raster state latched at the start of the frame, raster_count is 0 while it's off
+static const uint16_t* raster_palette = raster_palettes[0];
+static uint32_t raster_count = 0;
+static uint32_t raster_index = 0;
+
+#if FRAME_SCANLINE_PROFILE
+// Cycles of every core1 scanline callback, measured with the core1 SysTick. Only core1 writes
+// the statistics, core0 asks for a reset and core1 does it at the next scanline 0.
+#define SCANLINE_PROFILE_MASK 0x00FFFFFF
+
+static volatile frame_scanline_stats_t scanline_stats;
+static volatile bool scanline_stats_reset = true;
+
+// One scanline buffer is shown on DVI_VERTICAL_REPEAT output lines, 10 system clocks per pixel
+static uint32_t scanline_budget_cycles() {
+    const struct dvi_timing* timing = &DVI_TIMING;
+    const uint32_t pixels = timing->h_front_porch + timing->h_sync_width +
+                            timing->h_back_porch + timing->h_active_pixels;
+    return pixels * 10 * DVI_VERTICAL_REPEAT;
+}
+#endif
 
 static __not_in_flash("core1_main") void core1_main() {
+#if FRAME_SCANLINE_PROFILE
+    // 24 bit down counter at the system clock, free running
+    systick_hw->csr = 0;
+    systick_hw->rvr = SCANLINE_PROFILE_MASK;
+    systick_hw->cvr = 0;
+    systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+#endif
+
     dvi_register_irqs_this_core(&dvi0, DMA_IRQ_0);
     dvi_start(&dvi0);
     dvi_scanbuf_main_16bpp(&dvi0);
     __builtin_unreachable();
 }
 
-static inline bool __not_in_flash("is_pixel_set")
-    is_pixel_set(const frame_t* frame, uint8_t x, uint8_t y) {
-    size_t i = (y / 8) * 128;
-    y &= 7;
-    i += x;
-    return (frame->data[i] & (1 << y)) != 0;
+static lut_row_t __scratch_x("lut_row") lut_row;
+
+static void __not_in_flash("buf_fill") buf_fill(uint32_t* buf, size_t size, uint32_t pair) {
+    kernel_fill(buf, size, pair);
 }
 
-static void __not_in_flash("buf_set_color_h")
-    buf_set_color_h(uint16_t* buf, size_t x, uint16_t color) {
-    buf[32 + x * 2 + 0] = color;
-    buf[32 + x * 2 + 1] = color;
+static void __not_in_flash("fill_border_h") fill_border_h(uint16_t* buf, uint32_t pair) {
+    uint32_t* dst = (uint32_t*)buf;
+
+    // All offsets and sizes below are in pixel pairs
+    buf_fill(&dst[0], picture_left / 2, pair);
+    buf_fill(&dst[picture_right / 2], (FRAME_WIDTH - picture_right) / 2, pair);
 }
 
-static void __not_in_flash("buf_set_color_v")
-    buf_set_color_v(uint16_t* buf, size_t x, uint16_t color) {
-    buf[32 + 96 + x + 0] = color;
+static void __not_in_flash("fill_scanline_h")
+    fill_scanline_h(uint16_t* buf, uint row, const lut_row_t* lut) {
+    kernel_scanline_h(
+        (uint32_t*)&buf[picture_left],
+        current->frame.data,
+        row,
+        frame_scales[frame_scale].columns,
+        lut);
 }
 
-static void __not_in_flash("fill_scanline_h") fill_scanline_h(uint16_t* buf, uint scanline) {
-    int32_t frame_y = scanline / 3 - 8;
+static void __not_in_flash("fill_scanline_h_flip")
+    fill_scanline_h_flip(uint16_t* buf, uint row, const lut_row_t* lut) {
+    kernel_scanline_h_flip(
+        (uint32_t*)&buf[picture_left],
+        current->frame.data,
+        row,
+        frame_scales[frame_scale].columns,
+        lut);
+}
 
-    for(size_t frame_x = 0; frame_x < 128; frame_x++) {
-        uint16_t color = color_bg;
+// Vertical is turned clockwise, VerticalFlip the other way
+static void __not_in_flash("fill_scanline_v")
+    fill_scanline_v(uint16_t* buf, uint row, const lut_row_t* lut) {
+    kernel_scanline_v(
+        (uint32_t*)&buf[picture_left],
+        current->frame.data,
+        row,
+        frame_orientation == OrientationVertical,
+        lut);
+}
 
-        if(frame_y >= 0 && frame_y < 64) {
-            if(is_pixel_set(&current.frame, frame_x, frame_y)) {
-                color = color_fg;
-            }
-        }
+// Expand one picture row in the latched orientation, the borders are left alone
+static void __not_in_flash("fill_picture")
+    fill_picture(uint16_t* buf, uint row, const lut_row_t* lut) {
+    switch(frame_orientation) {
+    case OrientationHorizontalFlip:
+        fill_scanline_h_flip(buf, row, lut);
+        break;
+    case OrientationVertical:
+    case OrientationVerticalFlip:
+        fill_scanline_v(buf, row, lut);
+        break;
+    default:
+        fill_scanline_h(buf, row, lut);
+        break;
+    }
+}
+
+static inline bool orientation_is_vertical(uint8_t orientation) {
+    return orientation == OrientationVertical || orientation == OrientationVerticalFlip;
+}
+
+static inline bool __not_in_flash("scanline_is_pool") scanline_is_pool(const uint16_t* buf) {
+    return buf >= scanline_pool[0] && buf < scanline_pool[FRAME_SCANLINE_DEPTH];
+}
 
-        buf_set_color_h(buf, frame_x, color);
+// The cached rows and blank lines come back through q_colour_free as well, they're not reused
+static void __not_in_flash("scanline_recycle") scanline_recycle() {
+    uint16_t* buf;
+
+    while(queue_try_remove_u32(&dvi0.q_colour_free, &buf)) {
+        if(scanline_is_pool(buf) && scanline_free_count < FRAME_SCANLINE_DEPTH) {
+            scanline_free[scanline_free_count++] = buf;
+        }
     }
 }
 
-static void __not_in_flash("fill_scanline_v") fill_scanline_v(uint16_t* buf, uint scanline) {
-    int32_t frame_x = scanline - 50;
+static inline uint16_t* __not_in_flash("scanline_take") scanline_take() {
+    return scanline_free_count ? scanline_free[--scanline_free_count] : NULL;
+}
+
+static inline uint32_t* __not_in_flash("scanline_border_tag")
+    scanline_border_tag(const uint16_t* buf) {
+    return &scanline_border[(buf - scanline_pool[0]) / FRAME_WIDTH];
+}
 
-    for(size_t frame_y = 0; frame_y < 64; frame_y++) {
-        uint16_t color = color_bg;
+static uint16_t* __not_in_flash("vertical_line") vertical_line(uint row) {
+    uint16_t* buf = scanline_take();
+    if(buf == NULL) return NULL;
+
+    uint32_t* tag = scanline_border_tag(buf);
+    if(*tag != border_epoch) {
+        fill_border_h(buf, lut_row.h[0]);
+        *tag = border_epoch;
+    }
 
-        if(frame_x >= 0 && frame_x < 128) {
-            if(is_pixel_set(&current.frame, frame_x, 64 - 1 - frame_y)) {
-                color = color_fg;
+    fill_scanline_v(buf, row, &lut_row);
+    return buf;
+}
+
+static inline void __not_in_flash("row_cache_invalidate") row_cache_invalidate(uint8_t pages) {
+    // Turned by 180 degrees, page n of the frame holds the rows of page 7 - n
+    if(frame_orientation == OrientationHorizontalFlip) {
+        pages = (uint8_t)((pages >> 4) | (pages << 4));
+        pages = (uint8_t)(((pages & 0xCC) >> 2) | ((pages & 0x33) << 2));
+        pages = (uint8_t)(((pages & 0xAA) >> 1) | ((pages & 0x55) << 1));
+    }
+
+    // Each valid word holds the rows of four pages
+    for(size_t i = 0; i < count_of(row_cache_valid); i++) {
+        uint32_t mask = 0;
+        for(size_t page = 0; page < 4; page++) {
+            if(pages & (1u << (i * 4 + page))) {
+                mask |= 0xFFu << (page * 8);
             }
         }
+        row_cache_valid[i] &= ~mask;
+    }
+}
 
-        buf_set_color_v(buf, frame_y, color);
+static inline void __not_in_flash("row_cache_reset") row_cache_reset() {
+    for(size_t i = 0; i < count_of(row_cache_valid); i++) {
+        row_cache_valid[i] = 0;
+        row_border_valid[i] = 0;
     }
 }
 
-static void __not_in_flash("core1_scanline_callback") core1_scanline_callback() {
-    static uint scanline = 0;
+static uint16_t* __not_in_flash("row_cache_get") row_cache_get(uint frame_y) {
+    const uint32_t mask = 1u << (frame_y & 31);
 
-    if(scanline == 0) {
-        if(mutex_try_enter(&data_mutex, NULL)) {
-            memcpy(&current, &next, sizeof(frame_data_t));
-            current.orientation = next.orientation;
-            mutex_exit(&data_mutex);
+    if(!(row_border_valid[frame_y / 32] & mask)) {
+        fill_border_h(row_cache[frame_y], lut_row.h[0]);
+        row_border_valid[frame_y / 32] |= mask;
+    }
+
+    if(!(row_cache_valid[frame_y / 32] & mask)) {
+        fill_picture(row_cache[frame_y], frame_y, &lut_row);
+        row_cache_valid[frame_y / 32] |= mask;
+    }
+
+    return row_cache[frame_y];
+}
+
+// The RP2040 cores have no exclusive access instructions, so the exchange is done under a
+// hardware spin lock which is held for a couple of instructions only.
+static inline uint8_t __not_in_flash("frame_exchange")
+    frame_exchange(volatile uint8_t* slot, uint8_t value) {
+    const uint32_t save = spin_lock_blocking(frame_lock);
+    const uint8_t previous = *slot;
+    *slot = value;
+    spin_unlock(frame_lock, save);
+    return previous;
+}
+
+static void __not_in_flash("layout_build") layout_build(uint8_t scale, uint8_t orientation) {
+    static const frame_scale_t unscaled = {.columns = 1, .rows = 1};
+    const bool vertical = orientation_is_vertical(orientation);
+    const frame_scale_t* mode = vertical ? &unscaled : &frame_scales[scale];
+    const uint width = (vertical ? FLIPPER_HEIGHT : FLIPPER_WIDTH) * mode->columns;
+    const uint height = (vertical ? FLIPPER_WIDTH : FLIPPER_HEIGHT) * mode->rows;
+    const uint top = (FRAME_HEIGHT - height) / 2;
+
+    frame_scale = scale;
+    frame_orientation = orientation;
+    border_epoch++;
+    picture_left = (FRAME_WIDTH - width) / 2;
+    picture_right = picture_left + width;
+
+    for(uint scanline = 0; scanline < FRAME_HEIGHT; scanline++) {
+        if(scanline >= top && scanline < top + height) {
+            row_map[scanline] = (scanline - top) / mode->rows;
+        } else {
+            row_map[scanline] = -1;
         }
     }
+}
 
-    // Discard any scanline pointers passed back
-    uint16_t* bufptr;
-    while(queue_try_remove_u32(&dvi0.q_colour_free, &bufptr))
-        ;
+static uint8_t __not_in_flash("orientation_latch") orientation_latch() {
+    switch(orientation_source) {
+    case FrameOrientationSourceFlipper:
+        return current->orientation & 3;
+    case FrameOrientationSourceHost:
+        return orientation_requested;
+    default:
+        return OrientationHorizontal;
+    }
+}
+
+static void __not_in_flash("frame_swap") frame_swap() {
+    // Only core1 clears the fresh flag, so a fresh frame can't disappear after this check
+    uint8_t dirty = 0;
+    if(frame_ready & FRAME_READY_FRESH) {
+        frame_front = frame_exchange(&frame_ready, frame_front) & ~FRAME_READY_FRESH;
+        current = &frames[frame_front];
+        dirty = current->dirty;
+        perf_record(PerfHistogramDisplay, time_us_32() - current->published_us);
+    }
+
+    // The bottom lines are blank in every layout, so no queued line is affected.
+    // The orientation only changes here, together with the frame it's shown for.
+    const uint8_t orientation = orientation_latch();
+    if(frame_scale != scale_requested || frame_orientation != orientation) {
+        layout_build(scale_requested, orientation);
+        row_cache_reset();
+    } else if(dirty) {
+        row_cache_invalidate(dirty);
+    }
+
+    // Colors only change here, at scanline 0, so a frame is never shown in two palettes
+    const uint32_t palette = palette_requested;
+    if(frame_bg != (uint16_t)palette || frame_fg != (uint16_t)(palette >> 16)) {
+        frame_bg = (uint16_t)palette;
+        frame_fg = (uint16_t)(palette >> 16);
+        row_cache_reset();
+        lut_row_build(&lut_row, frame_bg, frame_fg);
+        border_epoch++;
+
+        blank_line_index ^= 1;
+        buf_fill((uint32_t*)blank_line[blank_line_index], FRAME_WIDTH / 2, lut_row.h[0]);
+    }
+
+    const uint32_t raster = raster_requested;
+    raster_count = raster_enabled ? (raster & 0xFFFF) : 0;
+    raster_palette = raster_palettes[raster >> 16];
+    raster_index = raster_phase_requested;
+    if(raster_index >= raster_count) {
+        raster_index = 0;
+    }
 
-    // Get a pointer to the next scanline
-    bufptr = framebuf;
+    // Never wait for core0, a vsync it hasn't picked up yet is simply merged with this one
+    frame_count++;
+    if(multicore_fifo_wready()) {
+        sio_hw->fifo_wr = frame_count;
+        __sev();
+    }
+}
+
+// Raster lines are expanded every time, with their own background, bypassing the row cache
+static uint16_t* __not_in_flash("raster_line") raster_line(uint scanline) {
+    uint16_t* buf = scanline_take();
+    const int32_t frame_y = row_map[scanline];
+    lut_row_t lut;
 
-    for(size_t i = 0; i <= 32; i++) {
-        framebuf[i] = color_bg;
-        framebuf[FRAME_WIDTH - i] = color_bg;
+    lut_row_build(&lut, raster_palette[raster_index], frame_fg);
+    if(++raster_index == raster_count) {
+        raster_index = 0;
     }
 
-    if(orientation_enable && (current.orientation == OrientationVertical ||
-                              current.orientation == OrientationVerticalFlip)) {
-        fill_scanline_v(bufptr, scanline);
+    if(buf == NULL) return NULL;
+
+    // The borders get the raster background, vertical_line() has to redraw them
+    *scanline_border_tag(buf) = 0;
+    if(frame_y >= 0) {
+        fill_border_h(buf, lut.h[0]);
+        fill_picture(buf, frame_y, &lut);
     } else {
-        fill_scanline_h(bufptr, scanline);
+        buf_fill((uint32_t*)buf, FRAME_WIDTH / 2, lut.h[0]);
+    }
+
+    return buf;
+}
+
+// Render and queue the next scanline
+// @return the scanline number
+static uint __not_in_flash("scanline_render") scanline_render() {
+    // frame_init() has queued the first lines already
+    static uint scanline = FRAME_SCANLINE_DEPTH;
+    const uint rendered = scanline;
+
+    if(scanline == 0) {
+        frame_swap();
+    }
+
+    // The encoder has already consumed every queued line
+    if(queue_is_empty(&dvi0.q_colour_valid)) {
+        perf_count(PerfCounterScanlineOverruns);
+    }
+
+    scanline_recycle();
+
+    uint16_t* bufptr;
+    if(raster_count) {
+        bufptr = raster_line(scanline);
+    } else {
+        const int32_t row = row_map[scanline];
+
+        if(row < 0) {
+            bufptr = blank_line[blank_line_index];
+        } else if(orientation_is_vertical(frame_orientation)) {
+            bufptr = vertical_line(row);
+        } else {
+            bufptr = row_cache_get(row);
+        }
+    }
+
+    // Every pool buffer is still queued: show a blank line rather than overwrite one
+    if(bufptr == NULL) {
+        perf_count(PerfCounterScanlinePoolEmpty);
+        bufptr = blank_line[blank_line_index];
     }
 
     queue_add_blocking_u32(&dvi0.q_colour_valid, &bufptr);
 
     scanline = (scanline + 1) % FRAME_HEIGHT;
+    return rendered;
+}
+
+#if FRAME_SCANLINE_PROFILE
+static void __not_in_flash("scanline_profile") scanline_profile(uint scanline, uint32_t cycles) {
+    volatile frame_scanline_stats_t* stats = &scanline_stats;
+
+    if(scanline == 0 && scanline_stats_reset) {
+        stats->lines = 0;
+        stats->min_cycles = UINT32_MAX;
+        stats->max_cycles = 0;
+        stats->total_cycles = 0;
+        stats->over_budget = 0;
+        stats->worst_scanline = 0;
+        scanline_stats_reset = false;
+    }
+
+    stats->lines++;
+    stats->total_cycles += cycles;
+    if(cycles < stats->min_cycles) {
+        stats->min_cycles = cycles;
+    }
+    if(cycles > stats->max_cycles) {
+        stats->max_cycles = cycles;
+        stats->worst_scanline = scanline;
+    }
+    if(cycles > stats->budget_cycles) {
+        stats->over_budget++;
+    }
+}
+#endif
+
+static void __not_in_flash("core1_scanline_callback") core1_scanline_callback() {
+#if FRAME_SCANLINE_PROFILE
+#ifdef FRAME_SCANLINE_PROFILE_GPIO
+    sio_hw->gpio_set = 1u << FRAME_SCANLINE_PROFILE_GPIO;
+#endif
+    const uint32_t start = systick_hw->cvr;
+    const uint scanline = scanline_render();
+    const uint32_t cycles = (start - systick_hw->cvr) & SCANLINE_PROFILE_MASK;
+#ifdef FRAME_SCANLINE_PROFILE_GPIO
+    sio_hw->gpio_clr = 1u << FRAME_SCANLINE_PROFILE_GPIO;
+#endif
+    scanline_profile(scanline, cycles);
+#else
+    scanline_render();
+#endif
+}
+
+static void frame_on_vsync() {
+    uint32_t count = 0;
+
+    while(multicore_fifo_rvalid()) {
+        count = sio_hw->fifo_rd;
+    }
+    multicore_fifo_clear_irq();
+
+    if(count != 0 && vsync_callback) {
+        vsync_callback(count, vsync_context);
+    }
 }
 
 void frame_init() {
@@ -138,11 +576,45 @@ void frame_init() {
     dvi0.scanline_callback = core1_scanline_callback;
     dvi_init(&dvi0, next_striped_spin_lock_num(), next_striped_spin_lock_num());
 
-    // add two scanlines to the scanlines queue
-    queue_add_blocking_u32(&dvi0.q_colour_valid, &framebuf[0]);
-    queue_add_blocking_u32(&dvi0.q_colour_valid, &framebuf[FRAME_WIDTH]);
+    frame_lock = spin_lock_instance(next_striped_spin_lock_num());
+
+    lut_row_build(&lut_row, frame_bg, frame_fg);
+    layout_build(frame_scale, frame_orientation);
+    buf_fill((uint32_t*)blank_line[blank_line_index], FRAME_WIDTH / 2, lut_row.h[0]);
+
+    // Queue the first lines, blank in every layout, from the pool so they get recycled
+    for(size_t i = 0; i < FRAME_SCANLINE_DEPTH; i++) {
+        uint16_t* bufptr = scanline_pool[i];
+        buf_fill((uint32_t*)bufptr, FRAME_WIDTH / 2, lut_row.h[0]);
+        queue_add_blocking_u32(&dvi0.q_colour_valid, &bufptr);
+    }
+
+#if FRAME_SCANLINE_PROFILE
+    scanline_stats.budget_cycles = scanline_budget_cycles();
+#ifdef FRAME_SCANLINE_PROFILE_GPIO
+    gpio_init(FRAME_SCANLINE_PROFILE_GPIO);
+    gpio_set_dir(FRAME_SCANLINE_PROFILE_GPIO, GPIO_OUT);
+#endif
+#endif
 
     multicore_launch_core1(core1_main);
+
+    // The launch handshake used the FIFO, from now on it only carries vsync
+    multicore_fifo_drain();
+    multicore_fifo_clear_irq();
+    irq_set_exclusive_handler(SIO_IRQ_PROC0, frame_on_vsync);
+    irq_set_enabled(SIO_IRQ_PROC0, true);
+}
+
+void frame_set_vsync_callback(FrameVsyncCallback callback, void* context) {
+    irq_set_enabled(SIO_IRQ_PROC0, false);
+    vsync_callback = callback;
+    vsync_context = context;
+    irq_set_enabled(SIO_IRQ_PROC0, true);
+}
+
+uint32_t frame_get_count(void) {
+    return frame_count;
 }
 
 uint32_t frame_get_clock() {
@@ -153,15 +625,144 @@ uint32_t frame_get_voltage() {
     return VREG_VSEL;
 }
 
-void frame_parse_data(uint8_t orientation, const frame_t* frame, uint32_t timeout_ms) {
-    if(mutex_enter_timeout_ms(&data_mutex, timeout_ms)) {
-        memcpy(&next.frame, frame, sizeof(frame_t));
-        next.orientation = orientation;
-        mutex_exit(&data_mutex);
+bool frame_get_scanline_stats(frame_scanline_stats_t* stats) {
+#if FRAME_SCANLINE_PROFILE
+    // Field by field, core1 may be halfway through an update
+    stats->lines = scanline_stats.lines;
+    stats->min_cycles = scanline_stats.min_cycles;
+    stats->max_cycles = scanline_stats.max_cycles;
+    stats->total_cycles = scanline_stats.total_cycles;
+    stats->over_budget = scanline_stats.over_budget;
+    stats->worst_scanline = scanline_stats.worst_scanline;
+    stats->budget_cycles = scanline_stats.budget_cycles;
+    return !scanline_stats_reset;
+#else
+    (void)stats;
+    return false;
+#endif
+}
+
+void frame_reset_scanline_stats(void) {
+#if FRAME_SCANLINE_PROFILE
+    scanline_stats_reset = true;
+#endif
+}
+
+bool frame_parse_data(uint8_t orientation, const frame_t* frame) {
+    memcpy(frame_get_back_buffer(), frame, sizeof(frame_t));
+    return frame_commit(orientation);
+}
+
+frame_t* frame_get_back_buffer(void) {
+    return &frames[frame_back].frame;
+}
+
+const frame_t* frame_get_last_buffer(void) {
+    return &frames[frame_last].frame;
+}
+
+static uint8_t frame_diff(const frame_data_t* frame, const frame_data_t* last) {
+    if(frame->orientation != last->orientation) {
+        return FRAME_PAGES_ALL;
+    }
+
+    uint8_t dirty = 0;
+    for(size_t page = 0; page < FRAME_PAGES; page++) {
+        const size_t offset = page * FRAME_PAGE_SIZE;
+        if(memcmp(&frame->frame.data[offset], &last->frame.data[offset], FRAME_PAGE_SIZE)) {
+            dirty |= 1u << page;
+        }
+    }
+
+    return dirty;
+}
+
+bool frame_commit(uint8_t orientation) {
+    frame_data_t* frame = &frames[frame_back];
+    const frame_data_t* last = &frames[frame_last];
+
+    frame->orientation = orientation;
+    frame->dirty = frame_diff(frame, last);
+
+    if(frame->dirty == 0) {
+        // Nothing to show, the back buffer stays with the producer
+        perf_count(PerfCounterFramesSkipped);
+        return false;
+    }
+
+    // Only the producer sets the fresh flag, so a frame that is fresh here may be taken by core1
+    // before the exchange but never the other way round. Taking over its pages is then redundant
+    // but harmless, while a superseded frame always passes its changes on.
+    if(frame_ready & FRAME_READY_FRESH) {
+        frame->dirty |= last->dirty;
+    }
+
+    // Publish, taking over the previously published frame if core1 hasn't picked it up yet
+    frame->published_us = time_us_32();
+    frame_last = frame_back;
+    const uint8_t previous = frame_exchange(&frame_ready, frame_back | FRAME_READY_FRESH);
+    frame_back = previous & ~FRAME_READY_FRESH;
+
+    if(previous & FRAME_READY_FRESH) {
+        perf_count(PerfCounterFramesSuperseded);
+    }
+
+    return true;
+}
+
+void frame_set_scale(FrameScale scale) {
+    if(scale < FrameScaleCount) {
+        scale_requested = scale;
+    }
+}
+
+FrameScale frame_get_scale(void) {
+    return (FrameScale)scale_requested;
+}
+
+bool frame_set_raster(const uint16_t* palette, size_t count) {
+    if(count == 0 || count > FRAME_RASTER_PALETTE_MAX) return false;
+
+    raster_write_index ^= 1;
+    memcpy(raster_palettes[raster_write_index], palette, count * sizeof(uint16_t));
+    raster_requested = ((uint32_t)raster_write_index << 16) | count;
+
+    return true;
+}
+
+void frame_set_raster_enable(bool enable) {
+    raster_enabled = enable;
+}
+
+bool frame_get_raster_enable(void) {
+    return raster_enabled;
+}
+
+void frame_set_raster_phase(uint32_t phase) {
+    const uint32_t count = raster_requested & 0xFFFF;
+    if(count) {
+        raster_phase_requested = phase % count;
     }
 }
 
+void frame_set_orientation_source(FrameOrientationSource source) {
+    if(source < FrameOrientationSourceCount) {
+        orientation_source = source;
+    }
+}
+
+FrameOrientationSource frame_get_orientation_source(void) {
+    return (FrameOrientationSource)orientation_source;
+}
+
+void frame_set_orientation(Orientation orientation) {
+    orientation_requested = orientation & 3;
+}
+
+Orientation frame_get_orientation(void) {
+    return (Orientation)frame_orientation;
+}
+
 void frame_set_color(uint16_t bg, uint16_t fg) {
-    color_bg = bg;
-    color_fg = fg;
+    palette_requested = pixel_pair(bg, fg);
 }
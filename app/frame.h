@@ -1,16 +1,63 @@
 #pragma once
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 typedef struct {
-    const uint8_t data[1024];
+    uint8_t data[1024];
 } frame_t;
 
 void frame_init();
 
+/**
+ * Called on core0 in interrupt context at the start of every frame, with frame_get_count().
+ * Frames are merged if the callback is late, so always use the count instead of counting calls.
+ */
+typedef void (*FrameVsyncCallback)(uint32_t frame_count, void* context);
+
+void frame_set_vsync_callback(FrameVsyncCallback callback, void* context);
+
+/**
+ * @return number of frames started since boot, 60 per second
+ */
+uint32_t frame_get_count(void);
+
 uint32_t frame_get_clock();
 
 uint32_t frame_get_voltage();
 
+/**
+ * Cycles spent in the core1 scanline callback, with FRAME_SCANLINE_PROFILE builds only.
+ * A callback taking longer than budget_cycles, the time one scanline buffer is shown, is
+ * over budget: a few are absorbed by the queued lines, a steady stream breaks the picture.
+ */
+typedef struct {
+    uint32_t lines;
+    uint32_t min_cycles;
+    uint32_t max_cycles;
+    uint64_t total_cycles;
+    uint32_t over_budget;
+    // Scanline of max_cycles, 0 to 239
+    uint32_t worst_scanline;
+    uint32_t budget_cycles;
+} frame_scanline_stats_t;
+
+/**
+ * Get the statistics since boot or the last reset. Core1 keeps updating them, so the fields
+ * may be a few lines apart.
+ * @return false if the firmware was built without profiling or the reset is still pending
+ */
+bool frame_get_scanline_stats(frame_scanline_stats_t* stats);
+
+/**
+ * Restart the statistics, core1 does it at the start of the next frame.
+ */
+void frame_reset_scanline_stats(void);
+
 typedef enum {
     OrientationHorizontal = 0,
     OrientationHorizontalFlip = 1,
@@ -18,6 +65,103 @@ typedef enum {
     OrientationVerticalFlip = 3,
 } Orientation;
 
-void frame_parse_data(uint8_t orientation, const frame_t* frame, uint32_t timeout_ms);
+/**
+ * Publish a new frame, it will be shown starting from the next vsync.
+ * Never blocks, a frame that wasn't shown yet is replaced by the newer one.
+ * A frame identical to the last published one is dropped, only changed pages are re-rendered.
+ * Must be called from a single producer.
+ * @return true if the frame was published, false if nothing changed
+ */
+bool frame_parse_data(uint8_t orientation, const frame_t* frame);
+
+/**
+ * Get the buffer the next frame can be written into directly.
+ * The buffer belongs to the producer until frame_commit(), its previous contents are undefined.
+ */
+frame_t* frame_get_back_buffer(void);
+
+/**
+ * Get the last published frame, it stays valid and unchanged until the next frame_commit().
+ * Producer only.
+ */
+const frame_t* frame_get_last_buffer(void);
+
+/**
+ * Publish the frame written into the back buffer, same rules as frame_parse_data().
+ */
+bool frame_commit(uint8_t orientation);
+
+/**
+ * Set the picture colors in RGB565, they are applied together from the next vsync.
+ */
+void frame_set_color(uint16_t bg, uint16_t fg);
+
+/**
+ * Picture scale on the 640x480 output, the picture is centered and letterboxed.
+ */
+typedef enum {
+    FrameScale2x = 0, /**< 256x128 */
+    FrameScale4x = 1, /**< 512x256 */
+    FrameScaleFill = 2, /**< 512x384, rows stretched to fill the screen height */
+    FrameScaleCount,
+} FrameScale;
+
+/**
+ * Select the picture scale, it's applied from the next vsync.
+ */
+void frame_set_scale(FrameScale scale);
+
+FrameScale frame_get_scale(void);
+
+/**
+ * Where the shown orientation comes from.
+ */
+typedef enum {
+    FrameOrientationSourceFixed = 0, /**< Always OrientationHorizontal */
+    FrameOrientationSourceFlipper = 1, /**< The orientation published with every frame */
+    FrameOrientationSourceHost = 2, /**< The orientation set with frame_set_orientation() */
+    FrameOrientationSourceCount,
+} FrameOrientationSource;
+
+/**
+ * Select the orientation source, it's applied from the next vsync.
+ */
+void frame_set_orientation_source(FrameOrientationSource source);
+
+FrameOrientationSource frame_get_orientation_source(void);
+
+/**
+ * Request an orientation for FrameOrientationSourceHost, it's applied from the next vsync.
+ * Safe to call from any task, vertical orientations are never scaled.
+ */
+void frame_set_orientation(Orientation orientation);
+
+/**
+ * @return the orientation core1 shows in the current frame
+ */
+Orientation frame_get_orientation(void);
+
+#define FRAME_RASTER_PALETTE_MAX 256
+
+/**
+ * Set the raster effect palette: scanline n gets the background palette[(n + phase) % count].
+ * The palette is copied, set it at most once per frame.
+ * @return false if count is 0 or above FRAME_RASTER_PALETTE_MAX
+ */
+bool frame_set_raster(const uint16_t* palette, size_t count);
+
+/**
+ * Enable the raster effect, it replaces the frame_set_color() background from the next vsync.
+ */
+void frame_set_raster_enable(bool enable);
+
+bool frame_get_raster_enable(void);
+
+/**
+ * Move the raster effect to a new phase, it's applied from the next vsync.
+ */
+void frame_set_raster_phase(uint32_t phase);
 
-void frame_set_color(uint16_t bg, uint16_t fg);
\ No newline at end of file
+#ifdef __cplusplus
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,147 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * Scanline kernels of the display, plain C so the host benchmark builds them as well.
+ * They always inline, frame.c wraps them into functions placed in RAM for core1.
+ *
+ * The Flipper frame is 128x64, one byte per 8-row page column, least significant bit on top.
+ * Kernels write the picture part of a RGB565 scanline as pixel pairs, the first pixel in the
+ * low half. Rows count in display order for every orientation.
+ */
+
+#define FRAME_KERNEL_WIDTH 128
+#define FRAME_KERNEL_HEIGHT 64
+#define FRAME_KERNEL_PAGES (FRAME_KERNEL_HEIGHT / 8)
+
+#define FRAME_KERNEL static inline __attribute__((always_inline))
+
+// Pixel expansion tables, rebuilt on core1 whenever the latched palette changes.
+typedef struct {
+    // Horizontal: one source bit -> one pre-doubled pixel pair.
+    uint32_t h[2];
+    // Not doubled: two source bits, first pixel in bit 0 -> one pixel pair.
+    uint32_t h1[4];
+    // Not doubled, mirrored: two source bits, first pixel in bit 1 -> one pixel pair.
+    uint32_t h1r[4];
+} lut_row_t;
+
+FRAME_KERNEL uint32_t pixel_pair(uint16_t first, uint16_t second) {
+    return (uint32_t)first | ((uint32_t)second << 16);
+}
+
+FRAME_KERNEL void lut_row_build(lut_row_t* lut, uint16_t bg, uint16_t fg) {
+    lut->h[0] = pixel_pair(bg, bg);
+    lut->h[1] = pixel_pair(fg, fg);
+
+    lut->h1[0] = pixel_pair(bg, bg);
+    lut->h1[1] = pixel_pair(fg, bg);
+    lut->h1[2] = pixel_pair(bg, fg);
+    lut->h1[3] = pixel_pair(fg, fg);
+
+    lut->h1r[0] = lut->h1[0];
+    lut->h1r[1] = lut->h1[2];
+    lut->h1r[2] = lut->h1[1];
+    lut->h1r[3] = lut->h1[3];
+}
+
+FRAME_KERNEL void kernel_fill(uint32_t* dst, size_t size, uint32_t pair) {
+    for(size_t i = 0; i < size; i++) {
+        dst[i] = pair;
+    }
+}
+
+// One row, doubled (columns == 2) to 256 pixels or not to 128
+FRAME_KERNEL void kernel_scanline_h(
+    uint32_t* dst,
+    const uint8_t* frame,
+    unsigned row,
+    unsigned columns,
+    const lut_row_t* lut) {
+    const uint8_t* src = &frame[(row / 8) * FRAME_KERNEL_WIDTH];
+    const unsigned shift = row & 7;
+
+    if(columns == 2) {
+        for(size_t x = 0; x < FRAME_KERNEL_WIDTH; x += 4) {
+            dst[x + 0] = lut->h[(src[x + 0] >> shift) & 1];
+            dst[x + 1] = lut->h[(src[x + 1] >> shift) & 1];
+            dst[x + 2] = lut->h[(src[x + 2] >> shift) & 1];
+            dst[x + 3] = lut->h[(src[x + 3] >> shift) & 1];
+        }
+    } else {
+        for(size_t x = 0; x < FRAME_KERNEL_WIDTH; x += 4) {
+            const unsigned p0 = (src[x + 0] >> shift) & 1;
+            const unsigned p1 = (src[x + 1] >> shift) & 1;
+            const unsigned p2 = (src[x + 2] >> shift) & 1;
+            const unsigned p3 = (src[x + 3] >> shift) & 1;
+            dst[x / 2 + 0] = lut->h1[p0 | (p1 << 1)];
+            dst[x / 2 + 1] = lut->h1[p2 | (p3 << 1)];
+        }
+    }
+}
+
+// Turned by 180 degrees: the rows bottom up, each one read from its last byte
+FRAME_KERNEL void kernel_scanline_h_flip(
+    uint32_t* dst,
+    const uint8_t* frame,
+    unsigned row,
+    unsigned columns,
+    const lut_row_t* lut) {
+    const unsigned frame_y = FRAME_KERNEL_HEIGHT - 1 - row;
+    const uint8_t* src = &frame[(frame_y / 8) * FRAME_KERNEL_WIDTH + FRAME_KERNEL_WIDTH - 1];
+    const unsigned shift = frame_y & 7;
+
+    if(columns == 2) {
+        for(size_t x = 0; x < FRAME_KERNEL_WIDTH; x += 4) {
+            dst[x + 0] = lut->h[(src[-(int)x - 0] >> shift) & 1];
+            dst[x + 1] = lut->h[(src[-(int)x - 1] >> shift) & 1];
+            dst[x + 2] = lut->h[(src[-(int)x - 2] >> shift) & 1];
+            dst[x + 3] = lut->h[(src[-(int)x - 3] >> shift) & 1];
+        }
+    } else {
+        for(size_t x = 0; x < FRAME_KERNEL_WIDTH; x += 4) {
+            const unsigned p0 = (src[-(int)x - 0] >> shift) & 1;
+            const unsigned p1 = (src[-(int)x - 1] >> shift) & 1;
+            const unsigned p2 = (src[-(int)x - 2] >> shift) & 1;
+            const unsigned p3 = (src[-(int)x - 3] >> shift) & 1;
+            dst[x / 2 + 0] = lut->h1[p0 | (p1 << 1)];
+            dst[x / 2 + 1] = lut->h1[p2 | (p3 << 1)];
+        }
+    }
+}
+
+// One Flipper column per line, a byte per page gives four pixel pairs without any per-pixel
+// shifts. Turned clockwise the top row ends up on the right, so the pages are read bottom up
+// and every byte from its last row. Counter-clockwise is the other way round.
+FRAME_KERNEL void kernel_scanline_v(
+    uint32_t* dst,
+    const uint8_t* frame,
+    unsigned row,
+    bool clockwise,
+    const lut_row_t* lut) {
+    if(clockwise) {
+        const uint8_t* src = &frame[(FRAME_KERNEL_PAGES - 1) * FRAME_KERNEL_WIDTH + row];
+        for(size_t page = 0; page < FRAME_KERNEL_PAGES; page++) {
+            const uint8_t byte = *src;
+            dst[0] = lut->h1r[byte >> 6];
+            dst[1] = lut->h1r[(byte >> 4) & 3];
+            dst[2] = lut->h1r[(byte >> 2) & 3];
+            dst[3] = lut->h1r[byte & 3];
+            dst += 4;
+            src -= FRAME_KERNEL_WIDTH;
+        }
+    } else {
+        const uint8_t* src = &frame[FRAME_KERNEL_WIDTH - 1 - row];
+        for(size_t page = 0; page < FRAME_KERNEL_PAGES; page++) {
+            const uint8_t byte = *src;
+            dst[0] = lut->h1[byte & 3];
+            dst[1] = lut->h1[(byte >> 2) & 3];
+            dst[2] = lut->h1[(byte >> 4) & 3];
+            dst[3] = lut->h1[byte >> 6];
+            dst += 4;
+            src += FRAME_KERNEL_WIDTH;
+        }
+    }
+}
@@ -174,3 +174,53 @@
 #define ICM42688_AODR_3_125Hz 0x0D
 #define ICM42688_AODR_1_5625Hz 0x0E
 #define ICM42688_AODR_500Hz 0x0F
+
+// DEVICE_CONFIG
+#define ICM42688_SOFT_RESET_CONFIG (1 << 0)
+
+// INT_CONFIG
+#define ICM42688_INT2_MODE_LATCHED (1 << 5)
+#define ICM42688_INT2_DRIVE_PUSH_PULL (1 << 4)
+#define ICM42688_INT2_POLARITY_HIGH (1 << 3)
+
+// FIFO_CONFIG
+#define ICM42688_FIFO_MODE_BYPASS (0x00 << 6)
+#define ICM42688_FIFO_MODE_STREAM (0x01 << 6)
+
+// SIGNAL_PATH_RESET
+#define ICM42688_FIFO_FLUSH (1 << 1)
+
+// INTF_CONFIG0
+#define ICM42688_FIFO_COUNT_REC (1 << 6)
+#define ICM42688_FIFO_COUNT_BIG_ENDIAN (1 << 5)
+#define ICM42688_SENSOR_DATA_BIG_ENDIAN (1 << 4)
+#define ICM42688_UI_SIFS_I2C_OFF (0x03 << 0)
+
+// FIFO_CONFIG1
+#define ICM42688_FIFO_RESUME_PARTIAL_RD (1 << 6)
+#define ICM42688_FIFO_WM_GT_TH (1 << 5)
+#define ICM42688_FIFO_HIRES_EN (1 << 4)
+#define ICM42688_FIFO_TMST_FSYNC_EN (1 << 3)
+#define ICM42688_FIFO_TEMP_EN (1 << 2)
+#define ICM42688_FIFO_GYRO_EN (1 << 1)
+#define ICM42688_FIFO_ACCEL_EN (1 << 0)
+
+// INT_CONFIG1
+#define ICM42688_INT_TPULSE_8US (1 << 6)
+#define ICM42688_INT_TDEASSERT_DISABLE (1 << 5)
+#define ICM42688_INT_ASYNC_RESET (1 << 4)
+
+// INT_SOURCE3
+#define ICM42688_UI_DRDY_INT2_EN (1 << 3)
+#define ICM42688_FIFO_THS_INT2_EN (1 << 2)
+#define ICM42688_FIFO_FULL_INT2_EN (1 << 1)
+
+// FIFO packet header
+#define ICM42688_FIFO_HEADER_MSG (1 << 7)
+#define ICM42688_FIFO_HEADER_ACCEL (1 << 6)
+#define ICM42688_FIFO_HEADER_GYRO (1 << 5)
+#define ICM42688_FIFO_HEADER_20 (1 << 4)
+
+// FIFO packet 3: header, accel, gyro, temperature and timestamp
+#define ICM42688_FIFO_PACKET_SIZE 16
+#define ICM42688_FIFO_SIZE 2048
@@ -0,0 +1,54 @@
+#pragma once
+#include <stdint.h>
+#include "imu.h"
+
+/**
+ * Fixed-point helpers for the IMU path, the Cortex-M0+ has no FPU.
+ * Qn values are int32_t with n fractional bits: Q30 for unit vectors and quaternions,
+ * Q24 for angular rates in rad/s and Q16 for accelerations in g.
+ */
+
+#define FIXED_Q30_ONE (1 << 30)
+
+// Gyro LSB in rad/s, Q24: 2^24 * (pi / 180) * 2000 / 32768
+#define FIXED_GYRO_RAD_Q24_PER_LSB 17872
+
+_Static_assert(IMU_GYRO_FULL_SCALE_DPS == 2000, "FIXED_GYRO_RAD_Q24_PER_LSB is for 2000 dps");
+
+static inline int32_t fixed_mul(int32_t a, int32_t b, uint32_t shift) {
+    return (int32_t)(((int64_t)a * b) >> shift);
+}
+
+static inline int32_t fixed_mul_q30(int32_t a, int32_t b) {
+    return fixed_mul(a, b, 30);
+}
+
+static inline int32_t fixed_gyro_to_rad_q24(int16_t raw) {
+    return (int32_t)raw * FIXED_GYRO_RAD_Q24_PER_LSB;
+}
+
+static inline int32_t fixed_accel_to_g_q16(int16_t raw) {
+    return (int32_t)raw * (65536 / IMU_ACCEL_LSB_PER_G);
+}
+
+// Integer square root, rounded down
+static inline uint32_t fixed_sqrt(uint32_t x) {
+    uint32_t result = 0;
+    uint32_t bit = 1UL << 30;
+
+    while(bit > x) {
+        bit >>= 2;
+    }
+
+    while(bit != 0) {
+        if(x >= result + bit) {
+            x -= result + bit;
+            result = (result >> 1) + bit;
+        } else {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return result;
+}
@@ -0,0 +1,190 @@
+#include "fusion.h"
+#include "fixed.h"
+#include "imu.h"
+#include <assert.h>
+#include <pico/stdlib.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include "../task_create.h"
+
+// Filter gains 2 * Kp and 2 * Ki, Q16
+#define FUSION_TWO_KP_Q16 (1 << 16)
+#define FUSION_TWO_KI_Q16 1311 // 0.02
+
+// Samples handled per imu_read() call
+#define FUSION_BATCH 16
+
+typedef struct {
+    int32_t q[4];
+    // Integral feedback in rad/s, Q24
+    int32_t integral[3];
+    // Half the sample period in s, Q30
+    int32_t half_dt;
+    // 2 * Ki * dt, Q30
+    int32_t two_ki_dt;
+    uint32_t rate_hz;
+} fusion_state_t;
+
+static fusion_state_t fusion = {
+    .q = {FIXED_Q30_ONE, 0, 0, 0},
+};
+
+static fusion_output_t fusion_output = {
+    .quaternion = {FIXED_Q30_ONE, 0, 0, 0},
+    .gravity = {0, 0, FIXED_Q30_ONE},
+};
+
+static FusionCallback fusion_callback = NULL;
+static void* fusion_callback_context = NULL;
+
+static void fusion_set_rate(fusion_state_t* state, uint32_t rate_hz) {
+    state->rate_hz = rate_hz;
+    state->half_dt = FIXED_Q30_ONE / (2 * rate_hz);
+    state->two_ki_dt = (FUSION_TWO_KI_Q16 << 14) / rate_hz;
+}
+
+// Gravity direction seen from the estimate, halved
+static void fusion_half_gravity(const int32_t* q, int32_t* half) {
+    half[0] = fixed_mul_q30(q[1], q[3]) - fixed_mul_q30(q[0], q[2]);
+    half[1] = fixed_mul_q30(q[0], q[1]) + fixed_mul_q30(q[2], q[3]);
+    half[2] = fixed_mul_q30(q[0], q[0]) - FIXED_Q30_ONE / 2 + fixed_mul_q30(q[3], q[3]);
+}
+
+static void fusion_update(fusion_state_t* state, const imu_sample_t* sample) {
+    int32_t* q = state->q;
+    int32_t g[3];
+    for(size_t axis = 0; axis < 3; axis++) {
+        g[axis] = fixed_gyro_to_rad_q24(sample->gyro[axis]);
+    }
+
+    const int32_t ax = sample->accel[0];
+    const int32_t ay = sample->accel[1];
+    const int32_t az = sample->accel[2];
+    // Each square fits in 30 bits, so the sum fits in 32
+    const uint32_t norm2 = (uint32_t)(ax * ax) + (uint32_t)(ay * ay) + (uint32_t)(az * az);
+
+    // No correction in free fall
+    if(norm2 != 0) {
+        const int32_t norm = fixed_sqrt(norm2);
+
+        // Measured gravity as a unit vector: Q15 with a 32 bit divide, then Q30
+        const int32_t ux = (ax * 32768 / norm) * 32768;
+        const int32_t uy = (ay * 32768 / norm) * 32768;
+        const int32_t uz = (az * 32768 / norm) * 32768;
+
+        int32_t half_v[3];
+        fusion_half_gravity(q, half_v);
+
+        // Error is the cross product of measured and estimated gravity
+        int32_t half_e[3];
+        half_e[0] = fixed_mul_q30(uy, half_v[2]) - fixed_mul_q30(uz, half_v[1]);
+        half_e[1] = fixed_mul_q30(uz, half_v[0]) - fixed_mul_q30(ux, half_v[2]);
+        half_e[2] = fixed_mul_q30(ux, half_v[1]) - fixed_mul_q30(uy, half_v[0]);
+
+        for(size_t axis = 0; axis < 3; axis++) {
+            // Q30 * Q30 >> 36 and Q30 * Q16 >> 22 both give Q24 rad/s
+            state->integral[axis] += fixed_mul(half_e[axis], state->two_ki_dt, 36);
+            g[axis] += state->integral[axis] + fixed_mul(half_e[axis], FUSION_TWO_KP_Q16, 22);
+        }
+    }
+
+    // Rotation over half the sample period, Q24 rad/s * Q30 s >> 24 gives a Q30 angle
+    for(size_t axis = 0; axis < 3; axis++) {
+        g[axis] = fixed_mul(g[axis], state->half_dt, 24);
+    }
+
+    const int32_t qa = q[0];
+    const int32_t qb = q[1];
+    const int32_t qc = q[2];
+    q[0] += -fixed_mul_q30(qb, g[0]) - fixed_mul_q30(qc, g[1]) - fixed_mul_q30(q[3], g[2]);
+    q[1] += fixed_mul_q30(qa, g[0]) + fixed_mul_q30(qc, g[2]) - fixed_mul_q30(q[3], g[1]);
+    q[2] += fixed_mul_q30(qa, g[1]) - fixed_mul_q30(qb, g[2]) + fixed_mul_q30(q[3], g[0]);
+    q[3] += fixed_mul_q30(qa, g[2]) + fixed_mul_q30(qb, g[1]) - fixed_mul_q30(qc, g[0]);
+
+    // The quaternion stays close to unit length, one Newton step of 1 / sqrt is enough
+    int64_t norm2_q = 0;
+    for(size_t i = 0; i < 4; i++) {
+        norm2_q += fixed_mul_q30(q[i], q[i]);
+    }
+    const int32_t scale = FIXED_Q30_ONE + (int32_t)((FIXED_Q30_ONE - norm2_q) / 2);
+    for(size_t i = 0; i < 4; i++) {
+        q[i] = fixed_mul_q30(q[i], scale);
+    }
+}
+
+static void fusion_publish(const fusion_state_t* state) {
+    fusion_output_t output;
+    int32_t half_v[3];
+
+    fusion_half_gravity(state->q, half_v);
+    for(size_t i = 0; i < 4; i++) {
+        output.quaternion[i] = state->q[i];
+    }
+    for(size_t axis = 0; axis < 3; axis++) {
+        output.gravity[axis] = half_v[axis] * 2;
+    }
+
+    taskENTER_CRITICAL();
+    fusion_output = output;
+    const FusionCallback callback = fusion_callback;
+    void* context = fusion_callback_context;
+    taskEXIT_CRITICAL();
+
+    if(callback != NULL) {
+        callback(&output, context);
+    }
+}
+
+static void fusion_task(void* unused_arg) {
+    imu_reader_t reader;
+    imu_reader_init(&reader);
+
+    const bool listening = imu_add_listener(xTaskGetCurrentTaskHandle());
+    assert(listening);
+    (void)listening;
+
+    while(true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        const uint32_t rate_hz = imu_get_rate_hz(imu_get_rate());
+        if(rate_hz == 0) {
+            continue;
+        } else if(rate_hz != fusion.rate_hz) {
+            fusion_set_rate(&fusion, rate_hz);
+        }
+
+        imu_sample_t samples[FUSION_BATCH];
+        size_t count;
+        bool updated = false;
+        while((count = imu_read(&reader, samples, FUSION_BATCH)) > 0) {
+            for(size_t i = 0; i < count; i++) {
+                fusion_update(&fusion, &samples[i]);
+            }
+            updated = true;
+        }
+
+        if(updated) {
+            fusion_publish(&fusion);
+        }
+    }
+}
+
+void fusion_init(void) {
+    TaskHandle_t task_handle = NULL;
+    BaseType_t status =
+        TASK_CREATE(fusion_task, "fusion_task", 512, NULL, tskIDLE_PRIORITY + 2, &task_handle);
+    assert(status == pdPASS);
+}
+
+void fusion_get_output(fusion_output_t* output) {
+    taskENTER_CRITICAL();
+    *output = fusion_output;
+    taskEXIT_CRITICAL();
+}
+
+void fusion_set_callback(FusionCallback callback, void* context) {
+    taskENTER_CRITICAL();
+    fusion_callback = callback;
+    fusion_callback_context = context;
+    taskEXIT_CRITICAL();
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Mahony orientation filter on the IMU stream, in fixed point, updated at the sample rate.
+ */
+typedef struct {
+    // Orientation quaternion w, x, y, z, Q30
+    int32_t quaternion[4];
+    // Unit gravity vector in the chip frame, Q30
+    int32_t gravity[3];
+} fusion_output_t;
+
+/**
+ * Called from the fusion task after every burst of samples.
+ */
+typedef void (*FusionCallback)(const fusion_output_t* output, void* context);
+
+void fusion_init(void);
+
+void fusion_get_output(fusion_output_t* output);
+
+/**
+ * Set the callback, or NULL to remove it.
+ */
+void fusion_set_callback(FusionCallback callback, void* context);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,434 @@
+#include "imu.h"
+#include "ICM42688P_regs.h"
+#include <assert.h>
+#include <pico/stdlib.h>
+#include <hardware/dma.h>
+#include <hardware/gpio.h>
+#include <hardware/irq.h>
+#include <hardware/spi.h>
+#include <hardware/sync.h>
+#include "../task_create.h"
+
+#define IMU_SPI spi0
+#define IMU_PIN_SCK 2
+#define IMU_PIN_MOSI 3
+#define IMU_PIN_MISO 4
+#define IMU_PIN_CS 5
+#define IMU_PIN_INT2 7
+
+// The chip allows 24 MHz, the SPI divider rounds down from there
+#define IMU_SPI_BAUD (24 * 1000 * 1000)
+
+// FIFO packets moved by one DMA burst
+#define IMU_BURST_PACKETS 32
+#define IMU_BURST_SIZE (IMU_BURST_PACKETS * ICM42688_FIFO_PACKET_SIZE)
+
+// Samples per watermark interrupt: one interrupt per ms at every rate
+#define IMU_WATERMARK_HZ 1000
+
+// Drain the FIFO even if an interrupt was missed, well before it fills up at 8 kHz
+#define IMU_INT_TIMEOUT_MS 5
+#define IMU_DMA_TIMEOUT_MS 10
+
+#define IMU_LISTENERS_MAX 2
+
+#define IMU_EVENT_INT (1 << 0)
+#define IMU_EVENT_DMA (1 << 1)
+#define IMU_EVENT_CONFIG (1 << 2)
+
+// In ImuRate order
+static const struct {
+    uint32_t hz;
+    uint8_t odr;
+} imu_rates[ImuRateCount] = {
+    {0, 0},
+    {1000, ICM42688_GODR_1kHz},
+    {2000, ICM42688_GODR_2kHz},
+    {4000, ICM42688_GODR_4kHz},
+    {8000, ICM42688_GODR_8kHz},
+};
+
+static TaskHandle_t imu_task_handle = NULL;
+static volatile ImuRate imu_requested_rate = ImuRateOff;
+static volatile ImuRate imu_rate = ImuRateOff;
+static volatile ImuState imu_state = ImuStateStopped;
+static uint32_t imu_events = 0;
+
+static TaskHandle_t imu_listeners[IMU_LISTENERS_MAX];
+static volatile size_t imu_listeners_count = 0;
+
+static int imu_tx_dma_channel;
+static int imu_rx_dma_channel;
+static uint8_t imu_tx_buffer[1 + IMU_BURST_SIZE];
+static uint8_t imu_rx_buffer[1 + IMU_BURST_SIZE];
+
+// Single writer ring, readers check the write position to detect overwritten samples
+static imu_sample_t imu_ring[IMU_RING_SIZE];
+static volatile uint32_t imu_written = 0;
+
+static_assert((IMU_RING_SIZE & (IMU_RING_SIZE - 1)) == 0, "IMU_RING_SIZE must be a power of 2");
+
+static void imu_notify_from_isr(uint32_t event) {
+    BaseType_t higher_priority_task_woken = pdFALSE;
+    if(imu_task_handle != NULL) {
+        xTaskNotifyFromISR(imu_task_handle, event, eSetBits, &higher_priority_task_woken);
+    }
+    portYIELD_FROM_ISR(higher_priority_task_woken);
+}
+
+static void imu_on_int(void) {
+    if(gpio_get_irq_event_mask(IMU_PIN_INT2) & GPIO_IRQ_EDGE_RISE) {
+        gpio_acknowledge_irq(IMU_PIN_INT2, GPIO_IRQ_EDGE_RISE);
+        imu_notify_from_isr(IMU_EVENT_INT);
+    }
+}
+
+static void imu_on_dma(void) {
+    if(dma_channel_get_irq1_status(imu_rx_dma_channel)) {
+        dma_channel_acknowledge_irq1(imu_rx_dma_channel);
+        imu_notify_from_isr(IMU_EVENT_DMA);
+    }
+}
+
+// Wait for any of the events, the others stay pending
+static uint32_t imu_wait(uint32_t events, TickType_t timeout) {
+    while((imu_events & events) == 0) {
+        uint32_t notified;
+        if(xTaskNotifyWait(0, UINT32_MAX, &notified, timeout) == pdFALSE) {
+            return 0;
+        }
+        imu_events |= notified;
+    }
+
+    const uint32_t result = imu_events & events;
+    imu_events &= ~events;
+    return result;
+}
+
+static bool imu_write_reg(uint8_t addr, uint8_t value) {
+    const uint8_t cmd_data[2] = {(uint8_t)(addr & 0x7Fu), value};
+    gpio_put(IMU_PIN_CS, 0);
+    const bool res = spi_write_blocking(IMU_SPI, cmd_data, 2) == 2;
+    gpio_put(IMU_PIN_CS, 1);
+    return res;
+}
+
+static bool imu_read_mem(uint8_t addr, uint8_t* data, size_t len) {
+    bool res = false;
+    gpio_put(IMU_PIN_CS, 0);
+    do {
+        const uint8_t cmd_byte = addr | (1 << 7);
+        if(spi_write_blocking(IMU_SPI, &cmd_byte, 1) != 1) break;
+        if(spi_read_blocking(IMU_SPI, 0, data, len) != (int)len) break;
+        res = true;
+    } while(0);
+    gpio_put(IMU_PIN_CS, 1);
+    return res;
+}
+
+// Burst read of the FIFO, the task sleeps until the DMA is done
+static bool imu_read_fifo(size_t size) {
+    imu_tx_buffer[0] = ICM42688_FIFO_DATA | (1 << 7);
+
+    dma_channel_set_read_addr(imu_tx_dma_channel, imu_tx_buffer, false);
+    dma_channel_set_trans_count(imu_tx_dma_channel, 1 + size, false);
+    dma_channel_set_write_addr(imu_rx_dma_channel, imu_rx_buffer, false);
+    dma_channel_set_trans_count(imu_rx_dma_channel, 1 + size, false);
+
+    gpio_put(IMU_PIN_CS, 0);
+    dma_start_channel_mask((1u << imu_tx_dma_channel) | (1u << imu_rx_dma_channel));
+    const bool done = imu_wait(IMU_EVENT_DMA, pdMS_TO_TICKS(IMU_DMA_TIMEOUT_MS)) != 0;
+    gpio_put(IMU_PIN_CS, 1);
+
+    if(!done) {
+        dma_channel_abort(imu_tx_dma_channel);
+        dma_channel_abort(imu_rx_dma_channel);
+    }
+
+    return done;
+}
+
+static int16_t imu_get_int16(const uint8_t* data) {
+    return (int16_t)(data[0] | (data[1] << 8));
+}
+
+static void imu_publish(const uint8_t* packets, size_t count) {
+    uint32_t written = imu_written;
+
+    for(size_t i = 0; i < count; i++) {
+        const uint8_t* packet = &packets[i * ICM42688_FIFO_PACKET_SIZE];
+        const uint8_t header = packet[0];
+        const uint8_t expected = ICM42688_FIFO_HEADER_ACCEL | ICM42688_FIFO_HEADER_GYRO;
+        if((header & (ICM42688_FIFO_HEADER_MSG | expected)) != expected) continue;
+
+        imu_sample_t* sample = &imu_ring[written & (IMU_RING_SIZE - 1)];
+        for(size_t axis = 0; axis < 3; axis++) {
+            sample->accel[axis] = imu_get_int16(&packet[1 + axis * 2]);
+            sample->gyro[axis] = imu_get_int16(&packet[7 + axis * 2]);
+        }
+        sample->timestamp_us = (uint16_t)(packet[14] | (packet[15] << 8));
+
+        // Publish the sample before moving the write position past it
+        __dmb();
+        imu_written = ++written;
+    }
+
+    for(size_t i = 0; i < imu_listeners_count; i++) {
+        xTaskNotifyGive(imu_listeners[i]);
+    }
+}
+
+static void imu_drain(void) {
+    uint8_t count_data[2];
+    if(!imu_read_mem(ICM42688_FIFO_COUNTH, count_data, sizeof(count_data))) {
+        return;
+    }
+
+    // Little endian count in bytes, whole packets only
+    size_t packets = (count_data[0] | (count_data[1] << 8)) / ICM42688_FIFO_PACKET_SIZE;
+    while(packets > 0) {
+        const size_t burst = MIN(packets, IMU_BURST_PACKETS);
+        if(!imu_read_fifo(burst * ICM42688_FIFO_PACKET_SIZE)) {
+            break;
+        }
+
+        imu_publish(&imu_rx_buffer[1], burst);
+        packets -= burst;
+    }
+}
+
+static void imu_bus_init(void) {
+    gpio_init(IMU_PIN_CS);
+    gpio_set_dir(IMU_PIN_CS, GPIO_OUT);
+    gpio_put(IMU_PIN_CS, 1);
+
+    spi_init(IMU_SPI, IMU_SPI_BAUD);
+    spi_set_format(IMU_SPI, 8, SPI_CPOL_1, SPI_CPHA_1, SPI_MSB_FIRST);
+
+    gpio_set_function(IMU_PIN_SCK, GPIO_FUNC_SPI);
+    gpio_set_function(IMU_PIN_MOSI, GPIO_FUNC_SPI);
+    gpio_set_function(IMU_PIN_MISO, GPIO_FUNC_SPI);
+
+    gpio_init(IMU_PIN_INT2);
+    gpio_set_dir(IMU_PIN_INT2, GPIO_IN);
+}
+
+// Leave the pins as the IMU test expects to find them
+static void imu_bus_deinit(void) {
+    gpio_set_irq_enabled(IMU_PIN_INT2, GPIO_IRQ_EDGE_RISE, false);
+
+    spi_deinit(IMU_SPI);
+    gpio_set_function(IMU_PIN_SCK, GPIO_FUNC_NULL);
+    gpio_set_function(IMU_PIN_MOSI, GPIO_FUNC_NULL);
+    gpio_set_function(IMU_PIN_MISO, GPIO_FUNC_NULL);
+    gpio_set_function(IMU_PIN_CS, GPIO_FUNC_NULL);
+
+    gpio_set_dir(IMU_PIN_SCK, GPIO_IN);
+    gpio_set_dir(IMU_PIN_MOSI, GPIO_IN);
+    gpio_set_dir(IMU_PIN_MISO, GPIO_IN);
+    gpio_set_dir(IMU_PIN_CS, GPIO_IN);
+}
+
+static bool imu_chip_start(ImuRate rate) {
+    const uint32_t hz = imu_rates[rate].hz;
+    const uint8_t odr = imu_rates[rate].odr;
+    const uint16_t watermark = (hz / IMU_WATERMARK_HZ) * ICM42688_FIFO_PACKET_SIZE;
+
+    imu_write_reg(ICM42688_REG_BANK_SEL, 0);
+    imu_write_reg(ICM42688_DEVICE_CONFIG, ICM42688_SOFT_RESET_CONFIG);
+    vTaskDelay(pdMS_TO_TICKS(10));
+
+    uint8_t who_am_i = 0;
+    if(!imu_read_mem(ICM42688_WHO_AM_I, &who_am_i, 1) || who_am_i != ICM42688_WHOAMI) {
+        return false;
+    }
+
+    // Little endian data and FIFO count in bytes, SPI only
+    imu_write_reg(ICM42688_INTF_CONFIG0, ICM42688_UI_SIFS_I2C_OFF);
+
+    // INT2 pulses high on the FIFO watermark, short pulses are needed from 4 kHz up
+    imu_write_reg(
+        ICM42688_INT_CONFIG, ICM42688_INT2_DRIVE_PUSH_PULL | ICM42688_INT2_POLARITY_HIGH);
+    imu_write_reg(
+        ICM42688_INT_CONFIG1,
+        hz >= 4000 ? (ICM42688_INT_TPULSE_8US | ICM42688_INT_TDEASSERT_DISABLE) : 0);
+    imu_write_reg(ICM42688_INT_SOURCE0, 0);
+    imu_write_reg(ICM42688_INT_SOURCE3, ICM42688_FIFO_THS_INT2_EN | ICM42688_FIFO_FULL_INT2_EN);
+
+    imu_write_reg(ICM42688_FIFO_CONFIG, ICM42688_FIFO_MODE_STREAM);
+    imu_write_reg(
+        ICM42688_FIFO_CONFIG1,
+        ICM42688_FIFO_WM_GT_TH | ICM42688_FIFO_TMST_FSYNC_EN | ICM42688_FIFO_TEMP_EN |
+            ICM42688_FIFO_GYRO_EN | ICM42688_FIFO_ACCEL_EN);
+    imu_write_reg(ICM42688_FIFO_CONFIG2, watermark & 0xFF);
+    imu_write_reg(ICM42688_FIFO_CONFIG3, watermark >> 8);
+
+    imu_write_reg(ICM42688_ACCEL_CONFIG0, ICM42688_AFS_16G | odr);
+    imu_write_reg(ICM42688_GYRO_CONFIG0, ICM42688_GFS_2000DPS | odr);
+    imu_write_reg(
+        ICM42688_PWR_MGMT0,
+        ICM42688_PWR_TEMP_ON | ICM42688_PWR_GYRO_MODE_LN | ICM42688_PWR_ACCEL_MODE_LN);
+    vTaskDelay(pdMS_TO_TICKS(50));
+
+    imu_write_reg(ICM42688_SIGNAL_PATH_RESET, ICM42688_FIFO_FLUSH);
+    return true;
+}
+
+static void imu_chip_stop(void) {
+    imu_write_reg(ICM42688_INT_SOURCE3, 0);
+    imu_write_reg(ICM42688_FIFO_CONFIG, ICM42688_FIFO_MODE_BYPASS);
+    imu_write_reg(ICM42688_PWR_MGMT0, ICM42688_PWR_TEMP_OFF);
+}
+
+static void imu_apply_rate(void) {
+    const ImuRate rate = imu_requested_rate;
+    if(rate == imu_rate && imu_state != ImuStateNoDevice) {
+        return;
+    }
+
+    if(imu_state == ImuStateRunning) {
+        imu_chip_stop();
+        imu_bus_deinit();
+        imu_state = ImuStateStopped;
+    }
+
+    imu_rate = rate;
+    if(rate == ImuRateOff) {
+        imu_state = ImuStateStopped;
+        return;
+    }
+
+    imu_bus_init();
+    if(!imu_chip_start(rate)) {
+        imu_bus_deinit();
+        imu_state = ImuStateNoDevice;
+        return;
+    }
+
+    imu_events &= ~IMU_EVENT_INT;
+    gpio_set_irq_enabled(IMU_PIN_INT2, GPIO_IRQ_EDGE_RISE, true);
+    imu_state = ImuStateRunning;
+}
+
+static void imu_dma_init(void) {
+    imu_tx_dma_channel = dma_claim_unused_channel(true);
+    imu_rx_dma_channel = dma_claim_unused_channel(true);
+
+    dma_channel_config config = dma_channel_get_default_config(imu_tx_dma_channel);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_8);
+    channel_config_set_read_increment(&config, true);
+    channel_config_set_write_increment(&config, false);
+    channel_config_set_dreq(&config, spi_get_dreq(IMU_SPI, true));
+    dma_channel_configure(
+        imu_tx_dma_channel, &config, &spi_get_hw(IMU_SPI)->dr, imu_tx_buffer, 0, false);
+
+    config = dma_channel_get_default_config(imu_rx_dma_channel);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_8);
+    channel_config_set_read_increment(&config, false);
+    channel_config_set_write_increment(&config, true);
+    channel_config_set_dreq(&config, spi_get_dreq(IMU_SPI, false));
+    dma_channel_configure(
+        imu_rx_dma_channel, &config, imu_rx_buffer, &spi_get_hw(IMU_SPI)->dr, 0, false);
+
+    // DMA_IRQ_0 belongs to the DVI output on core1
+    dma_channel_set_irq1_enabled(imu_rx_dma_channel, true);
+    irq_add_shared_handler(DMA_IRQ_1, imu_on_dma, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_1, true);
+
+    gpio_add_raw_irq_handler(IMU_PIN_INT2, imu_on_int);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+}
+
+static void imu_task(void* unused_arg) {
+    imu_dma_init();
+
+    while(true) {
+        imu_apply_rate();
+
+        if(imu_state != ImuStateRunning) {
+            imu_wait(IMU_EVENT_CONFIG, portMAX_DELAY);
+            continue;
+        }
+
+        const uint32_t events =
+            imu_wait(IMU_EVENT_INT | IMU_EVENT_CONFIG, pdMS_TO_TICKS(IMU_INT_TIMEOUT_MS));
+        if(!(events & IMU_EVENT_CONFIG)) {
+            imu_drain();
+        }
+    }
+}
+
+void imu_init(void) {
+    BaseType_t status =
+        TASK_CREATE(imu_task, "imu_task", 512, NULL, tskIDLE_PRIORITY + 2, &imu_task_handle);
+    assert(status == pdPASS);
+
+    imu_set_rate(ImuRate1kHz);
+}
+
+void imu_set_rate(ImuRate rate) {
+    imu_requested_rate = rate;
+    xTaskNotify(imu_task_handle, IMU_EVENT_CONFIG, eSetBits);
+}
+
+ImuRate imu_get_rate(void) {
+    return imu_rate;
+}
+
+uint32_t imu_get_rate_hz(ImuRate rate) {
+    return imu_rates[rate].hz;
+}
+
+ImuState imu_get_state(void) {
+    return imu_state;
+}
+
+bool imu_add_listener(TaskHandle_t task) {
+    bool added = false;
+
+    taskENTER_CRITICAL();
+    if(imu_listeners_count < IMU_LISTENERS_MAX) {
+        imu_listeners[imu_listeners_count] = task;
+        imu_listeners_count++;
+        added = true;
+    }
+    taskEXIT_CRITICAL();
+
+    return added;
+}
+
+void imu_reader_init(imu_reader_t* reader) {
+    reader->position = imu_written;
+    reader->lost = 0;
+}
+
+size_t imu_read(imu_reader_t* reader, imu_sample_t* samples, size_t count) {
+    // The slot after the newest sample may be half written, so one less can be read
+    const uint32_t readable = IMU_RING_SIZE - 1;
+
+    while(true) {
+        const uint32_t written = imu_written;
+        __dmb();
+
+        if(written - reader->position > readable) {
+            reader->lost += written - reader->position - readable;
+            reader->position = written - readable;
+        }
+
+        const size_t available = written - reader->position;
+        const size_t size = MIN(count, available);
+        for(size_t i = 0; i < size; i++) {
+            samples[i] = imu_ring[(reader->position + i) & (IMU_RING_SIZE - 1)];
+        }
+
+        // The writer may have lapped the reader during the copy, start over from the new
+        // oldest sample in that case
+        __dmb();
+        if(imu_written - reader->position > readable) {
+            continue;
+        }
+
+        reader->position += size;
+        return size;
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Streaming service for the ICM42688P. The chip collects samples in its FIFO and raises INT2
+ * at a watermark, the IMU task then drains the FIFO over SPI DMA into a sample ring.
+ */
+
+#define IMU_ACCEL_FULL_SCALE_G 16
+#define IMU_GYRO_FULL_SCALE_DPS 2000
+
+// Raw sample units
+#define IMU_ACCEL_LSB_PER_G (32768 / IMU_ACCEL_FULL_SCALE_G)
+#define IMU_GYRO_LSB_PER_DPS (32768 / IMU_GYRO_FULL_SCALE_DPS)
+
+// Samples kept for the readers, a power of 2
+#define IMU_RING_SIZE 256
+
+typedef enum {
+    ImuRateOff,
+    ImuRate1kHz,
+    ImuRate2kHz,
+    ImuRate4kHz,
+    ImuRate8kHz,
+    ImuRateCount,
+} ImuRate;
+
+typedef enum {
+    ImuStateStopped,
+    ImuStateRunning,
+    ImuStateNoDevice,
+} ImuState;
+
+typedef struct {
+    int16_t accel[3];
+    int16_t gyro[3];
+    // Chip time of the sample in us, wraps every 65.5 ms
+    uint16_t timestamp_us;
+} imu_sample_t;
+
+typedef struct {
+    uint32_t position;
+    // Samples overwritten before they were read
+    uint32_t lost;
+} imu_reader_t;
+
+void imu_init(void);
+
+/**
+ * Start streaming at the given rate, or stop with ImuRateOff. Applied by the IMU task.
+ */
+void imu_set_rate(ImuRate rate);
+
+ImuRate imu_get_rate(void);
+
+uint32_t imu_get_rate_hz(ImuRate rate);
+
+ImuState imu_get_state(void);
+
+/**
+ * Notify a task with xTaskNotifyGive() after every burst of new samples.
+ * @return false if all listener slots are taken
+ */
+bool imu_add_listener(TaskHandle_t task);
+
+/**
+ * Start reading from the newest sample. Any number of readers can run at once,
+ * each one sees every sample unless it falls IMU_RING_SIZE or more behind.
+ */
+void imu_reader_init(imu_reader_t* reader);
+
+/**
+ * Copy up to count samples, oldest first.
+ * @return the number of samples copied
+ */
+size_t imu_read(imu_reader_t* reader, imu_sample_t* samples, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
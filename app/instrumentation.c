@@ -0,0 +1,31 @@
+#include "instrumentation.h"
+#include <malloc.h>
+#include <pico/stdlib.h>
+#include <hardware/structs/timer.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+// From the linker script
+extern char end;
+extern char __HeapLimit;
+
+void instrumentation_get_heap(instrumentation_heap_t* heap) {
+    // Every allocation, FreeRTOS objects included with heap_3, goes through newlib
+    const struct mallinfo info = mallinfo();
+
+    heap->total = &__HeapLimit - &end;
+    heap->used = info.uordblks;
+    heap->free = heap->total - heap->used;
+    heap->min_free = heap->total - info.arena;
+}
+
+#ifdef VGM_INSTRUMENTATION
+unsigned long instrumentation_get_run_time_counter(void) {
+    return timer_hw->timerawl;
+}
+
+void vApplicationStackOverflowHook(TaskHandle_t task, char* name) {
+    (void)task;
+    panic("Stack overflow in %s", name);
+}
+#endif
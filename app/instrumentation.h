@@ -0,0 +1,28 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Memory and task statistics. The task run time and stack checks need a VGM_INSTRUMENTATION
+ * build, the heap statistics are always there.
+ */
+
+typedef struct {
+    // Heap between the end of the static data and the core0 stack, in bytes
+    size_t total;
+    size_t used;
+    size_t free;
+    // Heap the allocator has never claimed. It keeps what it claims, so this is the lowest
+    // free memory since boot for anything but the allocator itself.
+    size_t min_free;
+} instrumentation_heap_t;
+
+void instrumentation_get_heap(instrumentation_heap_t* heap);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,15 +1,22 @@
 #include "led.h"
 #include "led_state.h"
 #include <FreeRTOS.h>
-#include <task.h>
+#include <timers.h>
 #include <assert.h>
 
+// Blue blink while waiting for the Flipper, each half of the period
+#define LED_BLINK_MS 250
+
 typedef enum {
     LED_STATE_WAIT,
     LED_STATE_ACTIVE,
 } led_state_t;
 
-volatile static led_state_t led_state = LED_STATE_WAIT;
+static led_state_t led_state = LED_STATE_WAIT;
+static bool led_blink_on = false;
+
+// Only runs while waiting, the active state is a steady light
+static TimerHandle_t led_timer = NULL;
 
 static void leds(bool red, bool green, bool blue) {
     led_red(red);
@@ -17,38 +24,60 @@ static void leds(bool red, bool green, bool blue) {
     led_blue(blue);
 }
 
-static void led_task(void* unused_arg) {
-    while(1) {
-        switch(led_state) {
-        case LED_STATE_WAIT:
-            leds(false, false, true);
-            vTaskDelay(pdMS_TO_TICKS(250));
-            leds(false, false, false);
-            vTaskDelay(pdMS_TO_TICKS(250));
-            break;
-        case LED_STATE_ACTIVE:
-            leds(false, true, false);
-            vTaskDelay(pdMS_TO_TICKS(500));
-            break;
-        default:
-            break;
-        }
+// Runs in the timer service task
+static void led_timer_callback(TimerHandle_t timer) {
+    (void)timer;
+    led_blink_on = !led_blink_on;
+    leds(false, false, led_blink_on);
+}
+
+static void led_state_set(led_state_t state) {
+    if(state == led_state) return;
+    led_state = state;
+
+    // Stop first, so a pending blink can't override the new state
+    xTimerStop(led_timer, 0);
+
+    switch(state) {
+    case LED_STATE_WAIT:
+        led_blink_on = true;
+        leds(false, false, true);
+        xTimerStart(led_timer, 0);
+        break;
+    case LED_STATE_ACTIVE:
+        leds(false, true, false);
+        break;
+    default:
+        break;
     }
 }
 
 void led_state_init(void) {
-    BaseType_t status;
+#if configSUPPORT_STATIC_ALLOCATION
+    static StaticTimer_t led_timer_buffer;
+    led_timer = xTimerCreateStatic(
+        "led_timer",
+        pdMS_TO_TICKS(LED_BLINK_MS),
+        pdTRUE,
+        NULL,
+        led_timer_callback,
+        &led_timer_buffer);
+#else
+    led_timer =
+        xTimerCreate("led_timer", pdMS_TO_TICKS(LED_BLINK_MS), pdTRUE, NULL, led_timer_callback);
+#endif
+    assert(led_timer != NULL);
 
-    TaskHandle_t led_task_handle = NULL;
-    status = xTaskCreate(led_task, "led_task", 128, NULL, 1, &led_task_handle);
-    assert(status == pdPASS);
-    (void)status;
+    // Commands wait in the timer queue until the scheduler starts
+    led_blink_on = true;
+    leds(false, false, true);
+    xTimerStart(led_timer, 0);
 }
 
 void led_state_wait(void) {
-    led_state = LED_STATE_WAIT;
+    led_state_set(LED_STATE_WAIT);
 }
 
 void led_state_active(void) {
-    led_state = LED_STATE_ACTIVE;
-}
\ No newline at end of file
+    led_state_set(LED_STATE_ACTIVE);
+}
@@ -9,23 +9,25 @@
 #include <pico/sem.h>
 #include <FreeRTOS.h>
 #include <task.h>
+#include "task_create.h"
 #include "frame.h"
 #include "led.h"
 #include "led_state.h"
 #include "uart.h"
 #include "usb.h"
-#include "bitmaps.h"
+#include "imu/imu.h"
+#include "imu/fusion.h"
+#include "orientation.h"
+#include "screen_assets.h"
 
 // Define rainbow colors in RGB565 format
-static const uint16_t rainbow_colors[] = {
-    0xF800, // Red
-    0xFC00, // Orange
-    0xFFE0, // Yellow
-    0x07E0, // Green
-    0x001F, // Blue
-    0x781F, // Indigo
-    0xF81F  // Violet
-};
+#define RAINBOW_RED 0xF800
+#define RAINBOW_ORANGE 0xFC00
+#define RAINBOW_YELLOW 0xFFE0
+#define RAINBOW_GREEN 0x07E0
+#define RAINBOW_BLUE 0x001F
+#define RAINBOW_INDIGO 0x781F
+#define RAINBOW_VIOLET 0xF81F
 
 static void init() {
     led_init();
@@ -40,78 +42,138 @@ static void init() {
     frame_init();
     usb_init();
     uart_protocol_init();
+    imu_init();
+    fusion_init();
+    orientation_init();
 
     led_red(false);
 }
 
 
-static const size_t rainbow_colors_count = sizeof(rainbow_colors) / sizeof(rainbow_colors[0]);
-static size_t current_color_index = 0;
-static uint16_t color_background;
-static const uint8_t totalSteps = 20; // Total steps for smooth transition
-static uint8_t currentStep = 0; // Current step in the transition
-
-// Function to linearly interpolate between two colors in RGB565 format
-uint16_t interpolate_color(uint16_t colorStart, uint16_t colorEnd, uint8_t step, uint8_t maxSteps) {
-    if(step >= maxSteps) return colorEnd;
-
-    int rStart = (colorStart >> 11) & 0x1F;
-    int gStart = (colorStart >> 5) & 0x3F;
-    int bStart = colorStart & 0x1F;
+#define RAINBOW_COLORS_COUNT 7
+#define RAINBOW_STEPS 20 // Total steps for smooth transition
+#define RAINBOW_FRAMES_PER_STEP 3
 
-    int rEnd = (colorEnd >> 11) & 0x1F;
-    int gEnd = (colorEnd >> 5) & 0x3F;
-    int bEnd = colorEnd & 0x1F;
+static uint16_t color_background;
+static size_t current_gradient_index = 0;
+static TaskHandle_t rainbow_task_handle = NULL;
+
+// Linear interpolation between two RGB565 colors, evaluated at compile time
+#define RGB565_R(c) (((c) >> 11) & 0x1F)
+#define RGB565_G(c) (((c) >> 5) & 0x3F)
+#define RGB565_B(c) ((c) & 0x1F)
+#define LERP(start, end, step) ((start) + ((end) - (start)) * (step) / RAINBOW_STEPS)
+#define INTERPOLATE_COLOR(start, end, step)                                \
+    (uint16_t)((LERP(RGB565_R(start), RGB565_R(end), step) << 11) |        \
+               (LERP(RGB565_G(start), RGB565_G(end), step) << 5) |         \
+               LERP(RGB565_B(start), RGB565_B(end), step))
+
+#define GRADIENT_STEPS(start, end)                                                              \
+    INTERPOLATE_COLOR(start, end, 0), INTERPOLATE_COLOR(start, end, 1),                         \
+        INTERPOLATE_COLOR(start, end, 2), INTERPOLATE_COLOR(start, end, 3),                     \
+        INTERPOLATE_COLOR(start, end, 4), INTERPOLATE_COLOR(start, end, 5),                     \
+        INTERPOLATE_COLOR(start, end, 6), INTERPOLATE_COLOR(start, end, 7),                     \
+        INTERPOLATE_COLOR(start, end, 8), INTERPOLATE_COLOR(start, end, 9),                     \
+        INTERPOLATE_COLOR(start, end, 10), INTERPOLATE_COLOR(start, end, 11),                   \
+        INTERPOLATE_COLOR(start, end, 12), INTERPOLATE_COLOR(start, end, 13),                   \
+        INTERPOLATE_COLOR(start, end, 14), INTERPOLATE_COLOR(start, end, 15),                   \
+        INTERPOLATE_COLOR(start, end, 16), INTERPOLATE_COLOR(start, end, 17),                   \
+        INTERPOLATE_COLOR(start, end, 18), INTERPOLATE_COLOR(start, end, 19)
+
+// The whole cycle, from every rainbow color towards the next one
+static const uint16_t rainbow_gradient[RAINBOW_COLORS_COUNT * RAINBOW_STEPS] = {
+    GRADIENT_STEPS(RAINBOW_RED, RAINBOW_ORANGE),
+    GRADIENT_STEPS(RAINBOW_ORANGE, RAINBOW_YELLOW),
+    GRADIENT_STEPS(RAINBOW_YELLOW, RAINBOW_GREEN),
+    GRADIENT_STEPS(RAINBOW_GREEN, RAINBOW_BLUE),
+    GRADIENT_STEPS(RAINBOW_BLUE, RAINBOW_INDIGO),
+    GRADIENT_STEPS(RAINBOW_INDIGO, RAINBOW_VIOLET),
+    GRADIENT_STEPS(RAINBOW_VIOLET, RAINBOW_RED),
+};
 
-    int r = rStart + ((rEnd - rStart) * step / maxSteps);
-    int g = gStart + ((gEnd - gStart) * step / maxSteps);
-    int b = bStart + ((bEnd - bStart) * step / maxSteps);
+// Cycle through the rainbow colors for the background with smooth transitions
+// The step follows the frame count, so the fade stays locked to the display even if a vsync
+// is missed
+void cycle_rainbow_background_colors_smooth(uint32_t frame_count) {
+    const size_t index = (frame_count / RAINBOW_FRAMES_PER_STEP) % count_of(rainbow_gradient);
+    if(index == current_gradient_index) return;
 
-    return (uint16_t)((r << 11) | (g << 5) | b);
+    current_gradient_index = index;
+    frame_set_color(rainbow_gradient[current_gradient_index], color_background);
+    frame_set_raster_phase(current_gradient_index);
 }
 
-// Modified function to cycle through the rainbow colors for the background with smooth transitions
-void cycle_rainbow_background_colors_smooth() {
-    uint16_t currentColor = rainbow_colors[current_color_index];
-    uint16_t nextColor = rainbow_colors[(current_color_index + 1) % rainbow_colors_count];
+// Only wake the task up when the next step is due
+static void rainbow_on_vsync(uint32_t frame_count, void* context) {
+    static uint32_t last_step = 0;
+    const uint32_t step = frame_count / RAINBOW_FRAMES_PER_STEP;
 
-    uint16_t interpolatedColor = interpolate_color(currentColor, nextColor, currentStep, totalSteps);
-    frame_set_color(interpolatedColor, color_background); // Update the background color
-
-    currentStep++;
-    if(currentStep >= totalSteps) {
-        currentStep = 0;
-        current_color_index = (current_color_index + 1) % rainbow_colors_count; // Move to the next color
+    if(step != last_step) {
+        BaseType_t higher_priority_task_woken = pdFALSE;
+        last_step = step;
+        vTaskNotifyGiveFromISR(rainbow_task_handle, &higher_priority_task_woken);
+        portYIELD_FROM_ISR(higher_priority_task_woken);
     }
 }
 
 void RainbowBackgroundColorCyclerTask(void *pvParameters) {
-    const TickType_t xDelay = 50 / portTICK_PERIOD_MS; // Adjust delay for smoother transitions
+    // The same gradient scrolls down the screen when the raster effect is on
+    frame_set_raster(rainbow_gradient, count_of(rainbow_gradient));
+    frame_set_vsync_callback(rainbow_on_vsync, NULL);
 
     while(1) {
-        cycle_rainbow_background_colors_smooth();
-        vTaskDelay(xDelay);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        cycle_rainbow_background_colors_smooth(frame_get_count());
     }
 }
 
 static void show_defaul_screen() {
-    uint8_t* frame_buffer = calloc(FLIPPER_BITMAP_SIZE, sizeof(uint8_t));
+    if(screen_asset_draw("default", frame_get_back_buffer())) {
+        frame_commit(OrientationHorizontal);
+    }
+}
+
+#if configSUPPORT_STATIC_ALLOCATION
+// Memory of the kernel's own tasks, requested by vTaskStartScheduler()
+void vApplicationGetIdleTaskMemory(
+    StaticTask_t** ppxIdleTaskTCBBuffer,
+    StackType_t** ppxIdleTaskStackBuffer,
+    uint32_t* pulIdleTaskStackSize) {
+    static StaticTask_t idle_task_tcb;
+    static StackType_t idle_task_stack[configMINIMAL_STACK_SIZE];
+
+    *ppxIdleTaskTCBBuffer = &idle_task_tcb;
+    *ppxIdleTaskStackBuffer = idle_task_stack;
+    *pulIdleTaskStackSize = configMINIMAL_STACK_SIZE;
+}
 
-    bitmap_xbm_to_screen_frame(
-        frame_buffer, bitmap_default_screen, FLIPPER_SCREEN_WIDTH, FLIPPER_SCREEN_HEIGHT);
-    frame_parse_data(OrientationHorizontal, (const frame_t*)frame_buffer, pdMS_TO_TICKS(1000));
+void vApplicationGetTimerTaskMemory(
+    StaticTask_t** ppxTimerTaskTCBBuffer,
+    StackType_t** ppxTimerTaskStackBuffer,
+    uint32_t* pulTimerTaskStackSize) {
+    static StaticTask_t timer_task_tcb;
+    static StackType_t timer_task_stack[configTIMER_TASK_STACK_DEPTH];
 
-    free(frame_buffer);
+    *ppxTimerTaskTCBBuffer = &timer_task_tcb;
+    *ppxTimerTaskStackBuffer = timer_task_stack;
+    *pulTimerTaskStackSize = configTIMER_TASK_STACK_DEPTH;
 }
+#endif
 
 int main() {
     init();
 
-    xTaskCreate(RainbowBackgroundColorCyclerTask, "RainbowBgColorCycler", 256, NULL, tskIDLE_PRIORITY + 1, NULL);
+    TASK_CREATE(
+        RainbowBackgroundColorCyclerTask,
+        "RainbowBgColorCycler",
+        256,
+        NULL,
+        tskIDLE_PRIORITY + 1,
+        &rainbow_task_handle);
 
     show_defaul_screen();
 
-    // init the led task
+    // Blink the led from the timer service
     led_state_init();
 
     vTaskStartScheduler();
@@ -0,0 +1,90 @@
+#include "orientation.h"
+#include <FreeRTOS.h>
+#include <task.h>
+#include "imu/fixed.h"
+#include "imu/fusion.h"
+
+// A new orientation has to lead the current one by this much gravity, about 15 degrees
+#define ORIENTATION_HYSTERESIS_Q30 (FIXED_Q30_ONE / 4)
+
+// Gravity in the screen plane needed to decide at all, the square of sin(30 degrees)
+#define ORIENTATION_TILT_MIN2_Q30 (FIXED_Q30_ONE / 4)
+
+// A new orientation has to hold this long before it's shown
+#define ORIENTATION_HOLD_MS 300
+
+// Screen axes in the chip frame, as the module is mounted on the Flipper
+#define ORIENTATION_RIGHT_AXIS 0
+#define ORIENTATION_UP_AXIS 1
+
+typedef struct {
+    uint8_t current;
+    uint8_t candidate;
+    TickType_t candidate_since;
+} orientation_state_t;
+
+static orientation_state_t orientation = {
+    .current = OrientationHorizontal,
+    .candidate = OrientationHorizontal,
+};
+
+// Gravity along the screen up direction of each orientation, in Orientation order. The
+// accelerometer reads the reaction to gravity, so the vector points up.
+static int32_t orientation_up(const int32_t* gravity, uint8_t orientation) {
+    switch(orientation) {
+    case OrientationHorizontalFlip:
+        return -gravity[ORIENTATION_UP_AXIS];
+    case OrientationVertical:
+        return gravity[ORIENTATION_RIGHT_AXIS];
+    case OrientationVerticalFlip:
+        return -gravity[ORIENTATION_RIGHT_AXIS];
+    default:
+        return gravity[ORIENTATION_UP_AXIS];
+    }
+}
+
+static void orientation_update(const fusion_output_t* output, void* context) {
+    orientation_state_t* state = context;
+    const int32_t* gravity = output->gravity;
+
+    // Lying flat, every orientation is as good as the other
+    const int32_t right = gravity[ORIENTATION_RIGHT_AXIS];
+    const int32_t up = gravity[ORIENTATION_UP_AXIS];
+    const int64_t tilt2 = (int64_t)fixed_mul_q30(right, right) + fixed_mul_q30(up, up);
+    if(tilt2 < ORIENTATION_TILT_MIN2_Q30) {
+        state->candidate = state->current;
+        return;
+    }
+
+    uint8_t best = state->current;
+    for(uint8_t i = 0; i < 4; i++) {
+        if(orientation_up(gravity, i) > orientation_up(gravity, best)) {
+            best = i;
+        }
+    }
+
+    const int64_t lead =
+        (int64_t)orientation_up(gravity, best) - orientation_up(gravity, state->current);
+    if(lead < ORIENTATION_HYSTERESIS_Q30) {
+        state->candidate = state->current;
+        return;
+    }
+
+    const TickType_t now = xTaskGetTickCount();
+    if(best != state->candidate) {
+        state->candidate = best;
+        state->candidate_since = now;
+    } else if(now - state->candidate_since >= pdMS_TO_TICKS(ORIENTATION_HOLD_MS)) {
+        state->current = best;
+        frame_set_orientation((Orientation)best);
+    }
+}
+
+void orientation_init(void) {
+    frame_set_orientation((Orientation)orientation.current);
+    fusion_set_callback(orientation_update, &orientation);
+}
+
+Orientation orientation_get(void) {
+    return (Orientation)orientation.current;
+}
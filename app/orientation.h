@@ -0,0 +1,23 @@
+#pragma once
+#include <stdbool.h>
+#include "frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Picture orientation from the IMU: the axis gravity points along in the screen plane picks
+ * the orientation, with hysteresis so the picture doesn't flap between two of them.
+ * The result is passed to frame_set_orientation(), it's shown with FrameOrientationSourceHost.
+ */
+void orientation_init(void);
+
+/**
+ * @return the orientation the device is held in, OrientationHorizontal until it's known
+ */
+Orientation orientation_get(void);
+
+#ifdef __cplusplus
+}
+#endif
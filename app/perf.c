@@ -0,0 +1,38 @@
+#include <pico/platform.h>
+#include <string.h>
+#include "perf.h"
+
+static volatile uint32_t perf_counters[PerfCounterCount];
+static volatile uint32_t perf_histograms[PerfHistogramCount][PERF_HISTOGRAM_BUCKETS];
+
+void __not_in_flash("perf_count") perf_count(PerfCounter counter) {
+    perf_counters[counter]++;
+}
+
+static inline uint32_t __not_in_flash("perf_bucket") perf_bucket(uint32_t us) {
+    uint32_t bucket = 0;
+
+    // Plain loop: the clz helper may live in flash and this also runs on core1
+    while(us && bucket < PERF_HISTOGRAM_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+
+    return bucket;
+}
+
+void __not_in_flash("perf_record") perf_record(PerfHistogram histogram, uint32_t us) {
+    perf_histograms[histogram][perf_bucket(us)]++;
+}
+
+void perf_get_snapshot(perf_snapshot_t* snapshot) {
+    for(size_t i = 0; i < PerfCounterCount; i++) {
+        snapshot->counters[i] = perf_counters[i];
+    }
+
+    for(size_t i = 0; i < PerfHistogramCount; i++) {
+        for(size_t bucket = 0; bucket < PERF_HISTOGRAM_BUCKETS; bucket++) {
+            snapshot->histograms[i][bucket] = perf_histograms[i][bucket];
+        }
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Frame pipeline counters and latency histograms.
+ * Every counter and histogram has a single writer (uart_task or core1), so updates are plain
+ * word stores without locks. Readers may see a snapshot that is a few events old.
+ */
+
+typedef enum {
+    PerfCounterFramesReceived, /**< Screen frames decoded from the host */
+    PerfCounterFramesSkipped, /**< Frames identical to the last one, not published */
+    PerfCounterFramesSuperseded, /**< Published frames replaced before core1 showed them */
+    PerfCounterChecksumErrors, /**< Expansion frames with a bad checksum */
+    PerfCounterHeartbeats, /**< Heartbeats received in an RPC session */
+    PerfCounterLinkResyncs, /**< Broken screen streams resumed at the current baud rate */
+    PerfCounterStreamRestarts, /**< Screen streams requested again in the same RPC session */
+    PerfCounterHandshakes, /**< Host answers to the presence pulse, full handshakes started */
+    PerfCounterScanlineOverruns, /**< Scanlines rendered after the encoder ran out of lines */
+    PerfCounterScanlinePoolEmpty, /**< Scanlines shown blank, no scanline buffer was free */
+    PerfCounterCount,
+} PerfCounter;
+
+typedef enum {
+    PerfHistogramReceive, /**< First data frame of a screen frame to the frame decoded */
+    PerfHistogramPublish, /**< Frame decoded to frame published */
+    PerfHistogramDisplay, /**< Frame published to frame swapped in at scanline 0 */
+    PerfHistogramRecovery, /**< Screen stream broken to the next frame received */
+    PerfHistogramCount,
+} PerfHistogram;
+
+/** Bucket n counts values in [2^(n-1), 2^n) us, bucket 0 counts zero, the last one the rest */
+#define PERF_HISTOGRAM_BUCKETS 20
+
+typedef struct {
+    uint32_t counters[PerfCounterCount];
+    uint32_t histograms[PerfHistogramCount][PERF_HISTOGRAM_BUCKETS];
+} perf_snapshot_t;
+
+void perf_count(PerfCounter counter);
+
+void perf_record(PerfHistogram histogram, uint32_t us);
+
+void perf_get_snapshot(perf_snapshot_t* snapshot);
+
+#ifdef __cplusplus
+}
+#endif
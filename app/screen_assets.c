@@ -0,0 +1,52 @@
+#include <string.h>
+#include "screen_assets.h"
+#include "screen_codec.h"
+
+const screen_asset_t* screen_asset_find(const char* name) {
+    for(size_t i = 0; i < screen_assets_count; i++) {
+        if(strcmp(screen_assets[i].name, name) == 0) {
+            return &screen_assets[i];
+        }
+    }
+
+    return NULL;
+}
+
+void screen_asset_player_init(screen_asset_player_t* player, const screen_asset_t* asset) {
+    player->asset = asset;
+    player->next = asset->data;
+    player->frame = 0;
+}
+
+bool screen_asset_player_next(
+    screen_asset_player_t* player,
+    frame_t* dst,
+    const frame_t* reference) {
+    if(player->frame == player->asset->frame_count) {
+        screen_asset_player_init(player, player->asset);
+    }
+
+    // Frames are read front to back, so XIP fetches whole cache lines in order
+    const uint8_t* record = player->next;
+    const size_t size = record[0] | (record[1] << 8);
+
+    screen_decoder_t decoder;
+    screen_decoder_init(&decoder, dst, player->frame == 0 ? NULL : reference);
+    screen_decoder_feed(&decoder, &record[2], size);
+
+    player->next = &record[2 + size];
+    player->frame++;
+
+    return screen_decoder_done(&decoder);
+}
+
+bool screen_asset_draw(const char* name, frame_t* dst) {
+    const screen_asset_t* asset = screen_asset_find(name);
+    if(asset == NULL) {
+        return false;
+    }
+
+    screen_asset_player_t player;
+    screen_asset_player_init(&player, asset);
+    return screen_asset_player_next(&player, dst, NULL);
+}
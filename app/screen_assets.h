@@ -0,0 +1,59 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Screens and animations packed from the assets directory by scripts/build_assets.py.
+ * Each frame is a 16 bit little endian size followed by the frame in the screen codec format,
+ * the first frame of an asset is ScreenCodecRle and the others are deltas to the frame before.
+ */
+typedef struct {
+    const char* name;
+    size_t frame_count;
+    const uint8_t* data;
+} screen_asset_t;
+
+extern const screen_asset_t screen_assets[];
+extern const size_t screen_assets_count;
+
+typedef struct {
+    const screen_asset_t* asset;
+    const uint8_t* next;
+    size_t frame;
+} screen_asset_player_t;
+
+/**
+ * @return the asset with the given name, or NULL
+ */
+const screen_asset_t* screen_asset_find(const char* name);
+
+/**
+ * Start playing an asset from its first frame.
+ */
+void screen_asset_player_init(screen_asset_player_t* player, const screen_asset_t* asset);
+
+/**
+ * Decode the next frame into dst, which may be the display back buffer, and loop at the end.
+ * reference must hold the frame decoded before, it's not used for the first frame.
+ * @return false if the asset data is malformed
+ */
+bool screen_asset_player_next(
+    screen_asset_player_t* player,
+    frame_t* dst,
+    const frame_t* reference);
+
+/**
+ * Decode the first frame of the named asset into dst.
+ * @return false if there is no such asset
+ */
+bool screen_asset_draw(const char* name, frame_t* dst);
+
+#ifdef __cplusplus
+}
+#endif
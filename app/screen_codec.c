@@ -0,0 +1,120 @@
+#include "screen_codec.h"
+
+#define SCREEN_CODEC_RUN 0x80
+#define SCREEN_CODEC_COUNT 0x7F
+
+typedef enum {
+    ScreenDecoderStateCodec,
+    ScreenDecoderStateControl,
+    ScreenDecoderStateRun,
+    ScreenDecoderStateLiteral,
+    ScreenDecoderStateError,
+} ScreenDecoderState;
+
+void screen_decoder_init(screen_decoder_t* decoder, frame_t* dst, const frame_t* reference) {
+    decoder->dst = dst->data;
+    decoder->reference = reference ? reference->data : NULL;
+    decoder->offset = 0;
+    decoder->state = ScreenDecoderStateCodec;
+    decoder->count = 0;
+}
+
+static bool screen_decoder_codec(screen_decoder_t* decoder, uint8_t codec) {
+    if(codec == ScreenCodecRle) {
+        decoder->reference = NULL;
+    } else if(codec != ScreenCodecDeltaRle || decoder->reference == NULL) {
+        return false;
+    }
+
+    return true;
+}
+
+// Emit count copies of value, the caller has checked that they fit
+static void screen_decoder_run(screen_decoder_t* decoder, uint8_t value, size_t count) {
+    uint8_t* dst = &decoder->dst[decoder->offset];
+
+    if(decoder->reference) {
+        const uint8_t* reference = &decoder->reference[decoder->offset];
+        for(size_t i = 0; i < count; i++) {
+            dst[i] = reference[i] ^ value;
+        }
+    } else {
+        for(size_t i = 0; i < count; i++) {
+            dst[i] = value;
+        }
+    }
+
+    decoder->offset += count;
+}
+
+static void screen_decoder_literal(screen_decoder_t* decoder, const uint8_t* data, size_t count) {
+    uint8_t* dst = &decoder->dst[decoder->offset];
+
+    if(decoder->reference) {
+        const uint8_t* reference = &decoder->reference[decoder->offset];
+        for(size_t i = 0; i < count; i++) {
+            dst[i] = reference[i] ^ data[i];
+        }
+    } else {
+        for(size_t i = 0; i < count; i++) {
+            dst[i] = data[i];
+        }
+    }
+
+    decoder->offset += count;
+}
+
+bool screen_decoder_feed(screen_decoder_t* decoder, const uint8_t* data, size_t size) {
+    while(size > 0 && decoder->state != ScreenDecoderStateError) {
+        const size_t left = sizeof(frame_t) - decoder->offset;
+
+        switch(decoder->state) {
+        case ScreenDecoderStateCodec:
+            decoder->state = screen_decoder_codec(decoder, *data) ? ScreenDecoderStateControl :
+                                                                    ScreenDecoderStateError;
+            data++;
+            size--;
+            break;
+
+        case ScreenDecoderStateControl:
+            decoder->count = (*data & SCREEN_CODEC_COUNT) + 1;
+            if(decoder->count > left) {
+                decoder->state = ScreenDecoderStateError;
+            } else if(*data & SCREEN_CODEC_RUN) {
+                decoder->state = ScreenDecoderStateRun;
+            } else {
+                decoder->state = ScreenDecoderStateLiteral;
+            }
+            data++;
+            size--;
+            break;
+
+        case ScreenDecoderStateRun:
+            screen_decoder_run(decoder, *data, decoder->count);
+            decoder->state = ScreenDecoderStateControl;
+            data++;
+            size--;
+            break;
+
+        case ScreenDecoderStateLiteral: {
+            const size_t count = (decoder->count < size) ? decoder->count : size;
+            screen_decoder_literal(decoder, data, count);
+            decoder->count -= count;
+            if(decoder->count == 0) {
+                decoder->state = ScreenDecoderStateControl;
+            }
+            data += count;
+            size -= count;
+        } break;
+
+        default:
+            break;
+        }
+    }
+
+    return decoder->state != ScreenDecoderStateError;
+}
+
+bool screen_decoder_done(const screen_decoder_t* decoder) {
+    return decoder->state == ScreenDecoderStateControl && decoder->offset == sizeof(frame_t);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "frame.h"
+
+/**
+ * Compact screen frame formats, enabled with ExpansionFrameControlCommandEnableScreenCodec.
+ *
+ * A gui_screen_frame.data field of exactly sizeof(frame_t) bytes is always a raw frame.
+ * Any other size starts with a ScreenCodec byte followed by the RLE stream of the frame:
+ * a control byte c and then either a run (c & 0x80) of (c & 0x7F) + 1 copies of the next byte,
+ * or (c + 1) literal bytes. The stream must expand to exactly sizeof(frame_t) bytes.
+ *
+ * ScreenCodecDeltaRle encodes the XOR of the frame with the previous frame of the same stream,
+ * so the first frame of every stream must be raw or ScreenCodecRle.
+ */
+typedef enum {
+    ScreenCodecRle = 0x01,
+    ScreenCodecDeltaRle = 0x02,
+} ScreenCodec;
+
+typedef struct {
+    uint8_t* dst;
+    const uint8_t* reference;
+    size_t offset;
+    uint8_t state;
+    uint8_t count;
+} screen_decoder_t;
+
+/**
+ * Start decoding a frame into dst, which may be the display back buffer.
+ * reference is the previous frame of the stream, or NULL if there is none yet.
+ */
+void screen_decoder_init(screen_decoder_t* decoder, frame_t* dst, const frame_t* reference);
+
+/**
+ * Decode the next part of the encoded data, it may be split at any byte.
+ * @return false if the data is malformed
+ */
+bool screen_decoder_feed(screen_decoder_t* decoder, const uint8_t* data, size_t size);
+
+/**
+ * @return true if the whole frame was decoded
+ */
+bool screen_decoder_done(const screen_decoder_t* decoder);
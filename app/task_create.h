@@ -0,0 +1,28 @@
+#pragma once
+#include <FreeRTOS.h>
+#include <task.h>
+
+/**
+ * Create a task. With VGM_STATIC_ALLOCATION the stack and the control block are static
+ * variables named after the task function, so use it once per function.
+ * @return pdPASS on success
+ */
+#if configSUPPORT_STATIC_ALLOCATION
+#define TASK_CREATE(function, name, stack_depth, parameters, priority, handle) \
+    ({                                                                         \
+        static StackType_t function##_stack[stack_depth];                      \
+        static StaticTask_t function##_tcb;                                    \
+        *(handle) = xTaskCreateStatic(                                         \
+            function,                                                          \
+            name,                                                              \
+            stack_depth,                                                       \
+            parameters,                                                        \
+            priority,                                                          \
+            function##_stack,                                                  \
+            &function##_tcb);                                                  \
+        (*(handle) != NULL) ? pdPASS : pdFAIL;                                 \
+    })
+#else
+#define TASK_CREATE(function, name, stack_depth, parameters, priority, handle) \
+    xTaskCreate(function, name, stack_depth, parameters, priority, handle)
+#endif
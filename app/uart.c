@@ -2,9 +2,12 @@
 #include <pico/stdlib.h>
 
 #include <hardware/gpio.h>
+#include <hardware/dma.h>
+#include <hardware/irq.h>
+#include <hardware/sync.h>
 #include <FreeRTOS.h>
 #include <task.h>
-#include <stream_buffer.h>
+#include "task_create.h"
 #include <stdlib.h>
 
 #include <pb_common.h>
@@ -16,54 +19,240 @@
 #include "led_state.h"
 #include "bitmaps.h"
 #include "expansion_protocol.h"
+#include "screen_codec.h"
+#include "perf.h"
 
 #define UART_ID uart0
-#define UART_IRQ UART0_IRQ
 #define UART_TX_PIN 0
 #define UART_RX_PIN 1
 #define UART_INIT_BAUD_RATE (9600UL)
-#define UART_BAUD_RATE (1843200UL)
+
+// Checksum errors at one baud rate, without enough clean frames in between, before stepping down
+#define EXPANSION_MODULE_BAUD_RATE_MAX_ERRORS (3UL)
+#define EXPANSION_MODULE_BAUD_RATE_CLEAN_FRAMES (1000UL)
 
 #define EXPANSION_MODULE_TIMEOUT_MS (EXPANSION_PROTOCOL_TIMEOUT_MS - 50UL)
 #define EXPANSION_MODULE_STARTUP_DELAY_MS (250UL)
-#define EXPANSION_MODULE_BUFFER_SIZE (sizeof(ExpansionFrame) + sizeof(ExpansionFrameChecksum))
 
-static StreamBufferHandle_t stream;
+// Link recovery: the RX side is drained until the line has been quiet for the idle time, at
+// most for the drain time, before streaming resumes at the current baud rate
+#define EXPANSION_MODULE_RESYNC_IDLE_MS (2UL)
+#define EXPANSION_MODULE_RESYNC_DRAIN_MS (50UL)
+// Screen frames still in flight from the broken stream, skipped while waiting for the
+// response to a new stream request
+#define EXPANSION_MODULE_RESTART_MAX_FRAMES (16UL)
+
+// RX DMA ring, must be aligned to its size for the DMA address wrapping
+#define UART_RX_RING_BITS (11U)
+#define UART_RX_RING_SIZE (1U << UART_RX_RING_BITS)
+// Transfers per DMA run, a multiple of the ring size so every run starts at the ring base
+#define UART_RX_DMA_COUNT (1UL << 31)
+// Period of the ring watcher, armed only while the reader waits: wakes it up once enough data
+// is in or the line is idle
+#define UART_RX_POLL_US (50)
+
+// Baud rates to negotiate, fastest first. All of them are generated from the 252 MHz
+// peripheral clock with less than 0.1% error.
+static const uint32_t expansion_baud_rates[] = {
+    4000000UL,
+    3000000UL,
+    2000000UL,
+    1843200UL,
+    921600UL,
+    460800UL,
+    230400UL,
+};
+
+static const size_t expansion_baud_rates_count =
+    sizeof(expansion_baud_rates) / sizeof(expansion_baud_rates[0]);
+
+// Fastest rate known to work, kept across reconnects
+static size_t baud_rate_index = 0;
+static uint32_t checksum_errors = 0;
+// Result of the last frame decode, tells a silent host from a corrupted stream
+static ExpansionProtocolStatus link_status = ExpansionProtocolStatusOk;
+// When the screen stream last broke, 0 once a frame came through again
+static uint64_t link_error_us = 0;
+
 static PB_Main rpc_message;
+// Current RPC session uses windowed acknowledgement
+static bool rpc_windowed = false;
+// Host agreed to send compact screen frames
+static bool screen_codec_enabled = false;
+
+static uint8_t __aligned(UART_RX_RING_SIZE) rx_ring[UART_RX_RING_SIZE];
+static uint rx_dma_channel;
+static volatile uint32_t rx_dma_base; // Bytes written by completed DMA runs
+static volatile uint32_t rx_read; // Bytes consumed by the reader
+static volatile size_t rx_wanted;
+static volatile TaskHandle_t rx_waiting_task;
+static repeating_timer_t rx_timer;
+static uint32_t rx_timer_written; // Ring position at the previous watcher run
+
+// Total number of bytes written into the ring, wraps with rx_read
+static uint32_t uart_rx_written() {
+    const uint32_t save = save_and_disable_interrupts();
+    const uint32_t written =
+        rx_dma_base + (UART_RX_DMA_COUNT - dma_hw->ch[rx_dma_channel].transfer_count);
+    restore_interrupts(save);
+    return written;
+}
+
+static size_t uart_rx_available() {
+    const uint32_t written = uart_rx_written();
+    const uint32_t available = written - rx_read;
+
+    if(available > UART_RX_RING_SIZE) {
+        // Overrun, whatever is in the ring now is garbage
+        rx_read = written;
+        return 0;
+    }
+
+    return available;
+}
+
+// DMA run complete interrupt handler
+static void uart_on_rx_dma() {
+    if(dma_channel_get_irq1_status(rx_dma_channel)) {
+        dma_channel_acknowledge_irq1(rx_dma_channel);
+        rx_dma_base += UART_RX_DMA_COUNT;
+        dma_channel_set_trans_count(rx_dma_channel, UART_RX_DMA_COUNT, true);
+    }
+}
+
+// Ring watcher, runs from the timer interrupt while a reader waits
+static bool uart_on_rx_timer(repeating_timer_t* timer) {
+    const TaskHandle_t task = rx_waiting_task;
+    const uint32_t written = uart_rx_written();
+
+    if(task != NULL) {
+        const uint32_t available = written - rx_read;
+
+        if(available >= rx_wanted || (available > 0 && written == rx_timer_written)) {
+            BaseType_t higher_priority_task_woken = pdFALSE;
+            rx_waiting_task = NULL;
+            vTaskNotifyGiveFromISR(task, &higher_priority_task_woken);
+            portYIELD_FROM_ISR(higher_priority_task_woken);
+        }
+    }
+
+    rx_timer_written = written;
+    return true;
+}
 
-// RX interrupt handler
-static void uart_on_rx() {
-    BaseType_t higher_priority_task_woken = pdFALSE;
+// Waits until data is in or the timeout has passed. A wake-up only means "look again", so a
+// spurious one never ends the wait early.
+static bool uart_rx_wait(size_t wanted, TickType_t timeout) {
+    const TickType_t start = xTaskGetTickCount();
 
-    while(uart_is_readable(UART_ID)) {
-        const uint8_t ch = uart_getc(UART_ID);
-        xStreamBufferSendFromISR(stream, &ch, sizeof(ch), &higher_priority_task_woken);
+    while(true) {
+        const TickType_t elapsed = xTaskGetTickCount() - start;
+        if(elapsed >= timeout) break;
+
+        rx_wanted = wanted;
+        rx_timer_written = uart_rx_written();
+        rx_waiting_task = xTaskGetCurrentTaskHandle();
+        // The watcher only runs for the wait, an idle or unplugged link costs no interrupts
+        add_repeating_timer_us(-UART_RX_POLL_US, uart_on_rx_timer, NULL, &rx_timer);
+        ulTaskNotifyTake(pdTRUE, timeout - elapsed);
+        cancel_repeating_timer(&rx_timer);
+        rx_waiting_task = NULL;
+        // The watcher may have fired between the timeout and the line above, don't leave its
+        // notification behind for the next wait
+        ulTaskNotifyValueClear(NULL, UINT32_MAX);
+
+        if(uart_rx_available() > 0) return true;
     }
 
-    portYIELD_FROM_ISR(higher_priority_task_woken);
+    return uart_rx_available() > 0;
+}
+
+// Drop whatever is still arriving, so the next frame is read from a frame boundary
+static void uart_rx_drain() {
+    const TickType_t start = xTaskGetTickCount();
+    uint32_t written = uart_rx_written();
+
+    do {
+        vTaskDelay(pdMS_TO_TICKS(EXPANSION_MODULE_RESYNC_IDLE_MS));
+        const uint32_t now = uart_rx_written();
+        if(now == written) break;
+        written = now;
+    } while(xTaskGetTickCount() - start < pdMS_TO_TICKS(EXPANSION_MODULE_RESYNC_DRAIN_MS));
+
+    rx_read = uart_rx_written();
+}
+
+static void uart_rx_init() {
+    rx_dma_channel = dma_claim_unused_channel(true);
+
+    dma_channel_config config = dma_channel_get_default_config(rx_dma_channel);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_8);
+    channel_config_set_read_increment(&config, false);
+    channel_config_set_write_increment(&config, true);
+    channel_config_set_ring(&config, true, UART_RX_RING_BITS);
+    channel_config_set_dreq(&config, uart_get_dreq(UART_ID, false));
+
+    // DMA_IRQ_0 belongs to the DVI output on core1
+    dma_channel_set_irq1_enabled(rx_dma_channel, true);
+    irq_add_shared_handler(
+        DMA_IRQ_1, uart_on_rx_dma, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_1, true);
+
+    dma_channel_configure(
+        rx_dma_channel,
+        &config,
+        rx_ring,
+        &uart_get_hw(UART_ID)->dr,
+        UART_RX_DMA_COUNT,
+        true);
+
+    // let the uart raise rx dma requests
+    hw_set_bits(&uart_get_hw(UART_ID)->dmacr, UART_UARTDMACR_RXDMAE_BITS);
 }
 
 // Receive frames
 static size_t expansion_receive_callback(uint8_t* data, size_t data_size, void* context) {
+    (void)context;
     size_t received_size = 0;
 
-    while(true) {
-        const size_t received_size_cur = xStreamBufferReceive(
-            stream,
-            data + received_size,
-            data_size - received_size,
-            pdMS_TO_TICKS(EXPANSION_MODULE_TIMEOUT_MS));
-        if(received_size_cur == 0) break;
-        received_size += received_size_cur;
-        if(received_size == data_size) break;
+    while(received_size != data_size) {
+        const size_t available = uart_rx_available();
+
+        if(available == 0) {
+            if(!uart_rx_wait(
+                   data_size - received_size, pdMS_TO_TICKS(EXPANSION_MODULE_TIMEOUT_MS))) {
+                break;
+            }
+            continue;
+        }
+
+        const size_t size = MIN(available, data_size - received_size);
+        for(size_t i = 0; i < size; i++) {
+            data[received_size + i] = rx_ring[(rx_read + i) & (UART_RX_RING_SIZE - 1)];
+        }
+
+        rx_read += size;
+        received_size += size;
     }
 
     return received_size;
 }
 
+static ExpansionProtocolStatus expansion_decode_frame(ExpansionFrame* frame) {
+    const ExpansionProtocolStatus status =
+        expansion_protocol_decode(frame, expansion_receive_callback, NULL);
+
+    link_status = status;
+    if(status == ExpansionProtocolStatusErrorChecksum) {
+        checksum_errors++;
+        perf_count(PerfCounterChecksumErrors);
+    }
+
+    return status;
+}
+
 static inline bool expansion_receive_frame(ExpansionFrame* frame) {
-    return expansion_protocol_decode(frame, expansion_receive_callback, NULL) ==
-           ExpansionProtocolStatusOk;
+    return expansion_decode_frame(frame) == ExpansionProtocolStatusOk;
 }
 
 static inline bool expansion_is_heartbeat_frame(const ExpansionFrame* frame) {
@@ -143,8 +332,14 @@ static bool expansion_send_data_request(const uint8_t* data, size_t data_size) {
 typedef struct {
     ExpansionFrame frame;
     size_t read_size; // Number of bytes already read from the data frame
+    size_t unacked; // Number of data frames read but not confirmed yet
+    uint64_t first_us; // Arrival of the first data frame, 0 until then
 } ExpansionRpcContext;
 
+typedef struct {
+    size_t unacked; // Number of data frames sent but not confirmed yet
+} ExpansionRpcSendContext;
+
 static inline bool expansion_rpc_is_read_complete(const ExpansionRpcContext* ctx) {
     return ctx->frame.content.data.size == ctx->read_size;
 }
@@ -154,8 +349,7 @@ static inline bool expansion_receive_frame_rpc_mode(ExpansionFrame* frame) {
     bool heartbeat_pending = false;
 
     while(true) {
-        const ExpansionProtocolStatus status =
-            expansion_protocol_decode(frame, expansion_receive_callback, NULL);
+        const ExpansionProtocolStatus status = expansion_decode_frame(frame);
 
         if(status == ExpansionProtocolStatusErrorCommunication) {
             if(!heartbeat_pending && expansion_send_heartbeat()) {
@@ -171,6 +365,7 @@ static inline bool expansion_receive_frame_rpc_mode(ExpansionFrame* frame) {
 
         if(expansion_is_heartbeat_frame(frame)) {
             heartbeat_pending = false;
+            perf_count(PerfCounterHeartbeats);
         } else {
             return true;
         }
@@ -189,6 +384,9 @@ static bool
             if(!expansion_is_data_frame(&ctx->frame)) break;
 
             ctx->read_size = 0;
+            if(ctx->first_us == 0) {
+                ctx->first_us = time_us_64();
+            }
         }
 
         const size_t current_size =
@@ -198,8 +396,11 @@ static bool
         ctx->read_size += current_size;
 
         if(expansion_rpc_is_read_complete(ctx)) {
-            // Confirm the frame
-            if(!expansion_send_status(ExpansionFrameErrorNone)) break;
+            // Confirm the frame, or the whole window in windowed mode
+            if(!rpc_windowed || ++ctx->unacked == EXPANSION_PROTOCOL_WINDOW_SIZE) {
+                if(!expansion_send_status(ExpansionFrameErrorNone)) break;
+                ctx->unacked = 0;
+            }
         }
 
         received_size += current_size;
@@ -208,6 +409,13 @@ static bool
     return (received_size == data_size);
 }
 
+// Confirm the rest of the window once a message is complete
+static bool expansion_rpc_finish_read(ExpansionRpcContext* ctx) {
+    if(ctx->unacked == 0) return true;
+    ctx->unacked = 0;
+    return expansion_send_status(ExpansionFrameErrorNone);
+}
+
 static bool expansion_receive_rpc_message(PB_Main* message) {
     ExpansionRpcContext ctx = {};
 
@@ -218,20 +426,29 @@ static bool expansion_receive_rpc_message(PB_Main* message) {
         .errmsg = NULL,
     };
 
-    return pb_decode_ex(&is, &PB_Main_msg, message, PB_DECODE_DELIMITED);
+    return pb_decode_ex(&is, &PB_Main_msg, message, PB_DECODE_DELIMITED) &&
+           expansion_rpc_finish_read(&ctx);
+}
+
+static inline bool expansion_receive_ack() {
+    ExpansionFrame rx_frame;
+    return expansion_receive_frame(&rx_frame) && expansion_is_success_frame(&rx_frame);
 }
 
 static bool
     expansion_rpc_encode_callback(pb_ostream_t* stream, const pb_byte_t* data, size_t data_size) {
+    ExpansionRpcSendContext* ctx = stream->state;
     size_t sent_size = 0;
 
     while(sent_size != data_size) {
         const size_t current_size = MIN(data_size - sent_size, EXPANSION_PROTOCOL_MAX_DATA_SIZE);
         if(!expansion_send_data_request(data + sent_size, current_size)) break;
 
-        ExpansionFrame rx_frame;
-        if(!expansion_receive_frame(&rx_frame)) break;
-        if(!expansion_is_success_frame(&rx_frame)) break;
+        // Wait for confirmation of the frame, or of the whole window in windowed mode
+        if(!rpc_windowed || ++ctx->unacked == EXPANSION_PROTOCOL_WINDOW_SIZE) {
+            if(!expansion_receive_ack()) break;
+            ctx->unacked = 0;
+        }
 
         sent_size += current_size;
     }
@@ -240,15 +457,22 @@ static bool
 }
 
 static bool expansion_send_rpc_message(PB_Main* message) {
+    ExpansionRpcSendContext ctx = {};
+
     pb_ostream_t os = {
         .callback = expansion_rpc_encode_callback,
-        .state = NULL,
+        .state = &ctx,
         .max_size = SIZE_MAX,
         .bytes_written = 0,
         .errmsg = NULL,
     };
 
-    const bool success = pb_encode_ex(&os, &PB_Main_msg, message, PB_ENCODE_DELIMITED);
+    bool success = pb_encode_ex(&os, &PB_Main_msg, message, PB_ENCODE_DELIMITED);
+    // The rest of the window is confirmed once the message is complete
+    if(success && ctx.unacked > 0) {
+        success = expansion_receive_ack();
+    }
+
     pb_release(&PB_Main_msg, message);
     return success;
 }
@@ -258,14 +482,13 @@ static inline bool expansion_is_success_rpc_response(const PB_Main* message) {
            message->which_content == PB_Main_empty_tag;
 }
 
-static inline bool expansion_is_input_rpc_response(const PB_Main* message) {
-    return message->command_id == 0 && message->command_status == PB_CommandStatus_OK &&
-           message->which_content == PB_Main_gui_send_input_event_request_tag;
+static inline bool expansion_is_screen_frame_rpc_message(const PB_Main* message) {
+    return message->command_id == 0 && message->which_content == PB_Main_gui_screen_frame_tag;
 }
 
-static inline bool expansion_is_screen_frame_rpc_response(const PB_Main* message) {
+static inline bool expansion_is_input_rpc_response(const PB_Main* message) {
     return message->command_id == 0 && message->command_status == PB_CommandStatus_OK &&
-           message->which_content == PB_Main_gui_screen_frame_tag;
+           message->which_content == PB_Main_gui_send_input_event_request_tag;
 }
 
 // Main states
@@ -283,28 +506,70 @@ static bool expansion_wait_ready() {
     return success;
 }
 
+static inline bool expansion_is_baud_rate_error_frame(const ExpansionFrame* frame) {
+    return frame->header.type == ExpansionFrameTypeStatus &&
+           frame->content.status.error == ExpansionFrameErrorBaudRate;
+}
+
+// Step down the ladder if the current rate keeps corrupting frames
+static void expansion_check_baud_rate() {
+    if(checksum_errors < EXPANSION_MODULE_BAUD_RATE_MAX_ERRORS) return;
+
+    checksum_errors = 0;
+    if(baud_rate_index + 1 < expansion_baud_rates_count) {
+        baud_rate_index++;
+    }
+}
+
 static bool expansion_handshake() {
-    bool success = false;
+    // Try the best known rate first, then every slower one the host may accept
+    for(size_t i = baud_rate_index; i < expansion_baud_rates_count; i++) {
+        const uint32_t baud_rate = expansion_baud_rates[i];
 
-    do {
-        if(!expansion_send_baud_rate_request(UART_BAUD_RATE)) break;
+        if(!expansion_send_baud_rate_request(baud_rate)) break;
         ExpansionFrame frame;
         if(!expansion_receive_frame(&frame)) break;
-        if(!expansion_is_success_frame(&frame)) break;
-        uart_set_baudrate(UART_ID, UART_BAUD_RATE);
-        vTaskDelay(pdMS_TO_TICKS(EXPANSION_PROTOCOL_BAUD_CHANGE_DT_MS));
-        success = true;
-    } while(false);
 
-    return success;
+        if(expansion_is_success_frame(&frame)) {
+            uart_set_baudrate(UART_ID, baud_rate);
+            vTaskDelay(pdMS_TO_TICKS(EXPANSION_PROTOCOL_BAUD_CHANGE_DT_MS));
+
+            if(i != baud_rate_index) {
+                baud_rate_index = i;
+                checksum_errors = 0;
+            }
+            return true;
+        }
+
+        if(!expansion_is_baud_rate_error_frame(&frame)) break;
+    }
+
+    return false;
+}
+
+static inline bool expansion_is_error_frame(const ExpansionFrame* frame) {
+    return frame->header.type == ExpansionFrameTypeStatus &&
+           frame->content.status.error != ExpansionFrameErrorNone;
 }
 
 static bool expansion_start_rpc() {
     bool success = false;
+    rpc_windowed = false;
 
     do {
-        if(!expansion_send_control_request(ExpansionFrameControlCommandStartRpc)) break;
         ExpansionFrame frame;
+
+        // Prefer windowed acknowledgement, fall back to stop-and-wait if it's refused
+        if(!expansion_send_control_request(ExpansionFrameControlCommandStartRpcWindowed)) break;
+        if(!expansion_receive_frame(&frame)) break;
+        if(expansion_is_success_frame(&frame)) {
+            rpc_windowed = true;
+            success = true;
+            break;
+        }
+        if(!expansion_is_error_frame(&frame)) break;
+
+        if(!expansion_send_control_request(ExpansionFrameControlCommandStartRpc)) break;
         if(!expansion_receive_frame(&frame)) break;
         if(!expansion_is_success_frame(&frame)) break;
         success = true;
@@ -345,16 +610,11 @@ static bool expansion_start_virtual_display() {
         if(!expansion_is_success_rpc_response(&rpc_message)) break;
 
         // Show the same picture on display
-        uint8_t* frame_buffer = calloc(FLIPPER_BITMAP_SIZE, sizeof(uint8_t));
-
+        frame_t* frame = frame_get_back_buffer();
         bitmap_xbm_to_screen_frame(
-            frame_buffer, bitmap_splash_screen, FLIPPER_SCREEN_WIDTH, FLIPPER_SCREEN_HEIGHT);
-        frame_parse_data(
-            OrientationHorizontal,
-            (const frame_t*)frame_buffer,
-            pdMS_TO_TICKS(EXPANSION_MODULE_TIMEOUT_MS));
+            frame->data, bitmap_splash_screen, FLIPPER_SCREEN_WIDTH, FLIPPER_SCREEN_HEIGHT);
+        frame_commit(OrientationHorizontal);
 
-        free(frame_buffer);
         success = true;
     } while(false);
 
@@ -403,7 +663,29 @@ static bool expansion_stop_virtual_display() {
     return success;
 }
 
-static bool expansion_start_screen_streaming() {
+static bool expansion_enable_screen_codec() {
+    bool success = false;
+    screen_codec_enabled = false;
+
+    do {
+        ExpansionFrame frame;
+
+        // A host that doesn't know the command refuses it and keeps sending raw frames
+        if(!expansion_send_control_request(ExpansionFrameControlCommandEnableScreenCodec)) break;
+        if(!expansion_receive_frame(&frame)) break;
+        if(expansion_is_success_frame(&frame)) {
+            screen_codec_enabled = true;
+        } else if(!expansion_is_error_frame(&frame)) {
+            break;
+        }
+        success = true;
+    } while(false);
+
+    return success;
+}
+
+// A host that is still streaming may send a few more screen frames before the response
+static bool expansion_request_screen_stream() {
     bool success = false;
 
     rpc_message.command_id = expansion_get_next_command_id();
@@ -411,42 +693,257 @@ static bool expansion_start_screen_streaming() {
     rpc_message.which_content = PB_Main_gui_start_screen_stream_request_tag;
     rpc_message.has_next = false;
 
-    do {
-        if(!expansion_send_rpc_message(&rpc_message)) break;
-        if(!expansion_receive_rpc_message(&rpc_message)) break;
-        if(!expansion_is_success_rpc_response(&rpc_message)) break;
-        success = true;
-    } while(false);
+    if(expansion_send_rpc_message(&rpc_message)) {
+        for(size_t i = 0; i <= EXPANSION_MODULE_RESTART_MAX_FRAMES; i++) {
+            if(!expansion_receive_rpc_message(&rpc_message)) break;
+            if(!expansion_is_screen_frame_rpc_message(&rpc_message)) {
+                success = expansion_is_success_rpc_response(&rpc_message);
+                break;
+            }
+
+            pb_release(&PB_Main_msg, &rpc_message);
+        }
+    }
 
     pb_release(&PB_Main_msg, &rpc_message);
     return success;
 }
 
-static void expansion_process_screen_streaming() {
+static bool expansion_start_screen_streaming() {
+    if(!expansion_enable_screen_codec()) return false;
+    return expansion_request_screen_stream();
+}
+
+// Screen frames are decoded field by field, so that the frame data goes straight from the
+// expansion data frames into the display back buffer, without the heap-allocated bytes field
+// that pb_decode would use for PB_Gui_ScreenFrame.data. Compact frames are expanded on the
+// fly by the screen decoder, reading the data field in frame sized pieces.
+
+typedef struct {
+    uint32_t command_id;
+    uint32_t command_status;
+    uint32_t content_tag;
+    uint32_t orientation;
+    bool has_data;
+} ExpansionScreenFrame;
+
+static bool expansion_decode_screen_frame_data(
+    pb_istream_t* stream,
+    frame_t* frame,
+    const frame_t* reference) {
+    screen_decoder_t decoder;
+    screen_decoder_init(&decoder, frame, reference);
+
+    while(stream->bytes_left) {
+        uint8_t data[EXPANSION_PROTOCOL_MAX_DATA_SIZE];
+        const size_t size = MIN(stream->bytes_left, sizeof(data));
+
+        if(!pb_read(stream, data, size)) return false;
+        if(!screen_decoder_feed(&decoder, data, size)) return false;
+    }
+
+    return screen_decoder_done(&decoder);
+}
+
+static bool expansion_decode_screen_frame_content(
+    pb_istream_t* stream,
+    ExpansionScreenFrame* message,
+    frame_t* frame,
+    const frame_t* reference) {
+    while(stream->bytes_left) {
+        pb_wire_type_t wire_type;
+        uint32_t tag;
+        bool eof;
+
+        if(!pb_decode_tag(stream, &wire_type, &tag, &eof)) return eof;
+
+        if(tag == PB_Gui_ScreenFrame_data_tag && wire_type == PB_WT_STRING) {
+            pb_istream_t data_stream;
+            if(!pb_make_string_substream(stream, &data_stream)) return false;
+
+            if(data_stream.bytes_left == sizeof(frame_t)) {
+                if(!pb_read(&data_stream, frame->data, sizeof(frame_t))) return false;
+                message->has_data = true;
+            } else if(screen_codec_enabled && data_stream.bytes_left > 0) {
+                message->has_data =
+                    expansion_decode_screen_frame_data(&data_stream, frame, reference);
+            }
+
+            if(!pb_close_string_substream(stream, &data_stream)) return false;
+        } else if(tag == PB_Gui_ScreenFrame_orientation_tag && wire_type == PB_WT_VARINT) {
+            if(!pb_decode_varint32(stream, &message->orientation)) return false;
+        } else if(!pb_skip_field(stream, wire_type)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool expansion_decode_screen_frame(
+    pb_istream_t* stream,
+    ExpansionScreenFrame* message,
+    frame_t* frame,
+    const frame_t* reference) {
+    while(stream->bytes_left) {
+        pb_wire_type_t wire_type;
+        uint32_t tag;
+        bool eof;
+
+        if(!pb_decode_tag(stream, &wire_type, &tag, &eof)) return eof;
+
+        if(tag == PB_Main_command_id_tag && wire_type == PB_WT_VARINT) {
+            if(!pb_decode_varint32(stream, &message->command_id)) return false;
+        } else if(tag == PB_Main_command_status_tag && wire_type == PB_WT_VARINT) {
+            if(!pb_decode_varint32(stream, &message->command_status)) return false;
+        } else if(tag == PB_Main_has_next_tag) {
+            if(!pb_skip_field(stream, wire_type)) return false;
+        } else if(tag == PB_Main_gui_screen_frame_tag && wire_type == PB_WT_STRING) {
+            pb_istream_t content_stream;
+            message->content_tag = tag;
+
+            if(!pb_make_string_substream(stream, &content_stream)) return false;
+            if(!expansion_decode_screen_frame_content(
+                   &content_stream, message, frame, reference)) {
+                return false;
+            }
+            if(!pb_close_string_substream(stream, &content_stream)) return false;
+        } else {
+            // Any other content: the message is consumed, but it's not a screen frame
+            message->content_tag = tag;
+            if(!pb_skip_field(stream, wire_type)) return false;
+        }
+    }
+
+    return true;
+}
+
+// reference is the previous frame of the stream for delta frames, NULL for the first one
+static bool expansion_receive_screen_frame(
+    frame_t* frame,
+    const frame_t* reference,
+    uint8_t* orientation) {
+    ExpansionRpcContext ctx = {};
+    ExpansionScreenFrame message = {};
+
+    pb_istream_t is = {
+        .callback = expansion_rpc_decode_callback,
+        .state = &ctx,
+        .bytes_left = SIZE_MAX,
+        .errmsg = NULL,
+    };
+
+    pb_istream_t message_stream;
+    if(!pb_make_string_substream(&is, &message_stream)) return false;
+    if(!expansion_decode_screen_frame(&message_stream, &message, frame, reference)) {
+        return false;
+    }
+    if(!pb_close_string_substream(&is, &message_stream)) return false;
+    if(!expansion_rpc_finish_read(&ctx)) return false;
+
+    *orientation = message.orientation;
+
+    if(message.command_id != 0 || message.command_status != PB_CommandStatus_OK ||
+       message.content_tag != PB_Main_gui_screen_frame_tag || !message.has_data) {
+        return false;
+    }
+
+    perf_record(PerfHistogramReceive, time_us_64() - ctx.first_us);
+    return true;
+}
+
+// Returns the number of frames received before the stream broke
+static uint32_t expansion_process_screen_streaming() {
+    uint32_t frames = 0;
+    uint32_t clean_frames = 0;
+    const frame_t* reference = NULL;
+
     while(true) {
-        if(!expansion_receive_rpc_message(&rpc_message)) break;
-        if(!expansion_is_screen_frame_rpc_response(&rpc_message)) break;
+        uint8_t orientation;
+        if(!expansion_receive_screen_frame(frame_get_back_buffer(), reference, &orientation)) {
+            break;
+        }
 
-        // Display frame
-        const PB_Gui_ScreenOrientation orientation =
-            rpc_message.content.gui_screen_frame.orientation;
-        const pb_byte_t* data = rpc_message.content.gui_screen_frame.data->bytes;
+        const uint64_t received_us = time_us_64();
+        perf_count(PerfCounterFramesReceived);
+        frames++;
 
-        frame_parse_data(
-            orientation, (const frame_t*)data, pdMS_TO_TICKS(EXPANSION_MODULE_TIMEOUT_MS));
+        if(link_error_us != 0) {
+            perf_record(PerfHistogramRecovery, received_us - link_error_us);
+            link_error_us = 0;
+        }
 
-        pb_release(&PB_Main_msg, &rpc_message);
+        // Display frame
+        if(frame_commit(orientation)) {
+            perf_record(PerfHistogramPublish, time_us_64() - received_us);
+        }
+        // Identical frames aren't published, so the last one always matches the host's frame
+        reference = frame_get_last_buffer();
+
+        // A long enough run of good frames forgives earlier checksum errors
+        if(++clean_frames == EXPANSION_MODULE_BAUD_RATE_CLEAN_FRAMES) {
+            clean_frames = 0;
+            checksum_errors = 0;
+        }
     }
 
-    pb_release(&PB_Main_msg, &rpc_message);
+    return frames;
+}
+
+// Recovery steps after the screen stream broke, cheapest first
+typedef enum {
+    ExpansionRecoveryResync, // Drain, confirm the pending frames and keep streaming
+    ExpansionRecoveryRestartStream, // Drain and send the stream request again
+    ExpansionRecoveryHandshake, // Start over from the presence pulse at the initial baud rate
+} ExpansionRecovery;
+
+// Assumes the host takes a status frame it didn't wait for as a no-op: the protocol doesn't
+// say, but a host blocked on the confirmation of frames that were dropped would otherwise
+// only move on after its own timeout, and end the session.
+static void expansion_resync() {
+    uart_rx_drain();
+    expansion_send_status(ExpansionFrameErrorNone);
+}
+
+// Stream screen frames, recovering from transient link errors in the same RPC session.
+// Returns when only a full handshake can help.
+static void expansion_stream_screen() {
+    ExpansionRecovery recovery = ExpansionRecoveryResync;
+
+    while(true) {
+        // A broken stream always resumes without a reference, so the first frame after a
+        // recovery must be a key frame: a delta frame fails and moves on to the next step
+        if(expansion_process_screen_streaming() > 0) {
+            recovery = ExpansionRecoveryResync;
+        }
+        if(link_error_us == 0) {
+            link_error_us = time_us_64();
+        }
+
+        // A silent host has most likely gone back to waiting for the presence pulse, and
+        // repeated checksum errors need a slower baud rate, both take a handshake
+        if(link_status == ExpansionProtocolStatusErrorCommunication) return;
+        if(checksum_errors >= EXPANSION_MODULE_BAUD_RATE_MAX_ERRORS) return;
+
+        if(recovery == ExpansionRecoveryResync) {
+            perf_count(PerfCounterLinkResyncs);
+            expansion_resync();
+            recovery = ExpansionRecoveryRestartStream;
+        } else if(recovery == ExpansionRecoveryRestartStream) {
+            perf_count(PerfCounterStreamRestarts);
+            uart_rx_drain();
+            // The codec agreement holds for the whole RPC session, only the stream is new
+            if(!expansion_request_screen_stream()) return;
+            recovery = ExpansionRecoveryHandshake;
+        } else {
+            return;
+        }
+    }
 }
 
 static void uart_task(void* unused_arg) {
     // startup delay (skip potential module insertion interference)
     vTaskDelay(pdMS_TO_TICKS(EXPANSION_MODULE_STARTUP_DELAY_MS));
-    // init stream buffer
-    stream = xStreamBufferCreate(EXPANSION_MODULE_BUFFER_SIZE, 1);
-    assert(stream != NULL);
 
     // init uart 0
     uart_init(uart0, UART_INIT_BAUD_RATE);
@@ -467,12 +964,8 @@ static void uart_task(void* unused_arg) {
     // disable hardware flow control
     uart_set_hw_flow(UART_ID, false, false);
 
-    // add uart irqs
-    irq_set_exclusive_handler(UART_IRQ, uart_on_rx);
-    irq_set_enabled(UART_IRQ, true);
-
-    // enable rx irq
-    uart_set_irq_enables(UART_ID, true, false);
+    // receive through the dma ring
+    uart_rx_init();
 
     // show splash screen only once per power-up
     bool splash_screen_shown = false;
@@ -481,6 +974,9 @@ static void uart_task(void* unused_arg) {
         // leds: activate waiting state
         led_state_wait();
 
+        // drop to a slower baud rate if the last sessions were unreliable
+        expansion_check_baud_rate();
+
         // reset baud rate to initial value
         uart_set_baudrate(UART_ID, UART_INIT_BAUD_RATE);
         // announce presence (one pulse high -> low)
@@ -488,6 +984,7 @@ static void uart_task(void* unused_arg) {
 
         // wait for host response
         if(!expansion_wait_ready()) continue;
+        perf_count(PerfCounterHandshakes);
         // negotiate baud rate
         if(!expansion_handshake()) continue;
         // start rpc
@@ -508,14 +1005,14 @@ static void uart_task(void* unused_arg) {
         }
         // start screen streaming
         if(!expansion_start_screen_streaming()) continue;
-        // process screen frame messages - returns only on error
-        expansion_process_screen_streaming();
+        // process screen frame messages - returns only once a handshake is needed
+        expansion_stream_screen();
     }
 }
 
 void uart_protocol_init(void) {
     TaskHandle_t uart_task_handle = NULL;
-    BaseType_t status = xTaskCreate(uart_task, "uart_task", 4 * 1024, NULL, 1, &uart_task_handle);
+    BaseType_t status = TASK_CREATE(uart_task, "uart_task", 4 * 1024, NULL, 1, &uart_task_handle);
     assert(status == pdPASS);
     (void)status;
 }
@@ -3,6 +3,7 @@
 #include <pico/stdlib.h>
 #include <FreeRTOS.h>
 #include <task.h>
+#include "task_create.h"
 #include "cli/cli.h"
 
 static void usb_task(void* unused_arg) {
@@ -13,6 +14,6 @@ static void usb_task(void* unused_arg) {
 
 void usb_init(void) {
     TaskHandle_t task_handle = NULL;
-    BaseType_t status = xTaskCreate(usb_task, "usb_task", 1024, NULL, 1, &task_handle);
+    BaseType_t status = TASK_CREATE(usb_task, "usb_task", 1024, NULL, 1, &task_handle);
     assert(status == pdPASS);
 }
\ No newline at end of file
@@ -0,0 +1,775 @@
+// Host benchmarks of the display, codec and protocol kernels.
+//
+// The kernels are the firmware's own: frame_kernels.h, bitmaps.c, screen_assets.c,
+// screen_codec.c and expansion_protocol.h build unchanged for the host. Every kernel output is
+// checked first, a mismatch fails the run, so a faster kernel can't silently draw a different
+// picture: scanlines against a pixel-by-pixel reference, the XBM converter and the codec
+// against the assets packed by scripts/build_assets.py, the protocol through a loopback.
+// Timings are host nanoseconds, only compare them with each other.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bitmaps.h"
+#include "expansion_protocol.h"
+#include "frame_kernels.h"
+#include "screen_assets.h"
+#include "screen_codec.h"
+
+// The XBM asset itself, packed separately by scripts/build_assets.py into the "default" screen
+#include "default.xbm"
+
+#define BENCH_MIN_NS 200000000ULL
+
+#define BENCH_BG 0xFC00
+#define BENCH_FG 0x0000
+
+// Scanline of the 320 pixel buffer the kernels write into
+#define BENCH_LINE_PAIRS 160
+
+// PB_Main around a raw gui_screen_frame: delimited length, tags, data length and orientation
+#define BENCH_RPC_OVERHEAD 12
+
+// 8N1 framing on the wire
+#define BENCH_UART_BITS_PER_BYTE 10
+
+#define BENCH_FPS_MAX 60
+
+typedef struct {
+    const char* name;
+    frame_t frame;
+} bench_image_t;
+
+typedef enum {
+    BenchOrientationHorizontal,
+    BenchOrientationHorizontalFlip,
+    BenchOrientationVertical,
+    BenchOrientationVerticalFlip,
+    BenchOrientationCount,
+} BenchOrientation;
+
+static const char* const bench_orientation_names[BenchOrientationCount] = {
+    "horizontal",
+    "horizontal flip",
+    "vertical",
+    "vertical flip",
+};
+
+static bench_image_t bench_images[4];
+static size_t bench_images_count = 0;
+
+// Keeps the compiler from dropping the work being measured
+static volatile uint32_t bench_sink;
+
+static uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+typedef void (*BenchFunction)(void* context);
+
+// Run the function until BENCH_MIN_NS have passed, doubling the batch every round
+static double bench_measure(BenchFunction function, void* context) {
+    uint64_t iterations = 1;
+
+    while(true) {
+        const uint64_t start = bench_now_ns();
+        for(uint64_t i = 0; i < iterations; i++) {
+            function(context);
+        }
+        const uint64_t elapsed = bench_now_ns() - start;
+
+        if(elapsed >= BENCH_MIN_NS) {
+            return (double)elapsed / iterations;
+        }
+        iterations *= 2;
+    }
+}
+
+static void bench_report(const char* name, double ns, size_t units, const char* unit) {
+    printf("  %-36s %10.1f ns", name, ns);
+    if(units > 1) {
+        printf("  %8.2f ns/%s", ns / units, unit);
+    }
+    printf("\n");
+}
+
+static bool bench_pixel(const frame_t* frame, unsigned x, unsigned y) {
+    return (frame->data[(y / 8) * FRAME_KERNEL_WIDTH + x] >> (y & 7)) & 1;
+}
+
+// Display geometry of every orientation: rows and pixels per row
+static unsigned bench_rows(BenchOrientation orientation) {
+    return orientation >= BenchOrientationVertical ? FRAME_KERNEL_WIDTH : FRAME_KERNEL_HEIGHT;
+}
+
+static unsigned bench_row_pixels(BenchOrientation orientation) {
+    return orientation >= BenchOrientationVertical ? FRAME_KERNEL_HEIGHT : FRAME_KERNEL_WIDTH;
+}
+
+// The reference picture: what a display pixel shows, straight from the rotation
+static bool bench_reference_pixel(
+    const frame_t* frame,
+    BenchOrientation orientation,
+    unsigned row,
+    unsigned column) {
+    switch(orientation) {
+    case BenchOrientationHorizontalFlip:
+        return bench_pixel(
+            frame, FRAME_KERNEL_WIDTH - 1 - column, FRAME_KERNEL_HEIGHT - 1 - row);
+    case BenchOrientationVertical:
+        return bench_pixel(frame, row, FRAME_KERNEL_HEIGHT - 1 - column);
+    case BenchOrientationVerticalFlip:
+        return bench_pixel(frame, FRAME_KERNEL_WIDTH - 1 - row, column);
+    default:
+        return bench_pixel(frame, column, row);
+    }
+}
+
+static void bench_kernel_row(
+    uint32_t* dst,
+    const frame_t* frame,
+    BenchOrientation orientation,
+    unsigned columns,
+    unsigned row,
+    const lut_row_t* lut) {
+    switch(orientation) {
+    case BenchOrientationHorizontalFlip:
+        kernel_scanline_h_flip(dst, frame->data, row, columns, lut);
+        break;
+    case BenchOrientationVertical:
+        kernel_scanline_v(dst, frame->data, row, true, lut);
+        break;
+    case BenchOrientationVerticalFlip:
+        kernel_scanline_v(dst, frame->data, row, false, lut);
+        break;
+    default:
+        kernel_scanline_h(dst, frame->data, row, columns, lut);
+        break;
+    }
+}
+
+// First pixel of a pair in the low half, read without aliasing the line as uint16_t
+static uint16_t bench_line_pixel(const uint32_t* line, unsigned column) {
+    return (uint16_t)(line[column / 2] >> ((column & 1) * 16));
+}
+
+static bool bench_check_kernel(
+    const bench_image_t* image,
+    BenchOrientation orientation,
+    unsigned columns,
+    const lut_row_t* lut) {
+    uint32_t line[BENCH_LINE_PAIRS] = {0};
+
+    for(unsigned row = 0; row < bench_rows(orientation); row++) {
+        bench_kernel_row(line, &image->frame, orientation, columns, row, lut);
+
+        for(unsigned column = 0; column < bench_row_pixels(orientation) * columns; column++) {
+            const bool set =
+                bench_reference_pixel(&image->frame, orientation, row, column / columns);
+            if(bench_line_pixel(line, column) != (set ? BENCH_FG : BENCH_BG)) {
+                printf(
+                    "  MISMATCH %s, %s %ux: row %u pixel %u\n",
+                    image->name,
+                    bench_orientation_names[orientation],
+                    columns,
+                    row,
+                    column);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Raw frames of the test images, same format as gui_screen_frame.data
+static void bench_add_image(const char* name, const frame_t* frame) {
+    bench_image_t* image = &bench_images[bench_images_count++];
+    image->name = name;
+    image->frame = *frame;
+}
+
+static void bench_images_init(void) {
+    frame_t frame;
+
+    bitmap_xbm_to_screen_frame(
+        frame.data, bitmap_splash_screen, FLIPPER_SCREEN_WIDTH, FLIPPER_SCREEN_HEIGHT);
+    bench_add_image("splash", &frame);
+
+    memset(frame.data, 0, sizeof(frame.data));
+    bench_add_image("blank", &frame);
+
+    for(unsigned x = 0; x < FRAME_KERNEL_WIDTH; x++) {
+        // Columns alternate between 0x55 and 0xAA: a one pixel checkerboard
+        for(unsigned page = 0; page < FRAME_KERNEL_PAGES; page++) {
+            frame.data[page * FRAME_KERNEL_WIDTH + x] = (x & 1) ? 0xAA : 0x55;
+        }
+    }
+    bench_add_image("checkerboard", &frame);
+
+    uint32_t seed = 0x12345678;
+    for(size_t i = 0; i < sizeof(frame.data); i++) {
+        seed = seed * 1664525 + 1013904223;
+        frame.data[i] = seed >> 24;
+    }
+    bench_add_image("noise", &frame);
+}
+
+// Screen codec encoder, the same choices as scripts/build_assets.py
+#define BENCH_CODEC_RUN 0x80
+#define BENCH_CODEC_COUNT_MAX 0x80
+#define BENCH_CODEC_RUN_MIN 3
+
+static size_t bench_rle_encode(uint8_t* out, const uint8_t* data, size_t size, uint8_t codec) {
+    size_t length = 0;
+    size_t literal = 0;
+    size_t literal_start = 0;
+    size_t i = 0;
+
+    out[length++] = codec;
+
+    while(i <= size) {
+        size_t run = 1;
+        while(i + run < size && run < BENCH_CODEC_COUNT_MAX && data[i + run] == data[i]) {
+            run++;
+        }
+
+        // Flush the literal before a run, at the end and when it's full
+        if(literal && (i == size || run >= BENCH_CODEC_RUN_MIN ||
+                       literal == BENCH_CODEC_COUNT_MAX)) {
+            out[length++] = literal - 1;
+            memcpy(&out[length], &data[literal_start], literal);
+            length += literal;
+            literal = 0;
+        }
+
+        if(i == size) break;
+
+        if(run >= BENCH_CODEC_RUN_MIN) {
+            out[length++] = BENCH_CODEC_RUN | (run - 1);
+            out[length++] = data[i];
+            i += run;
+        } else {
+            if(literal == 0) {
+                literal_start = i;
+            }
+            literal++;
+            i++;
+        }
+    }
+
+    return length;
+}
+
+// Worst case of the encoder: a literal control byte for every 128 bytes and the codec byte
+#define BENCH_RLE_MAX (sizeof(frame_t) + sizeof(frame_t) / BENCH_CODEC_COUNT_MAX + 2)
+
+static bool bench_check_codec(const bench_image_t* image, const frame_t* reference) {
+    uint8_t encoded[BENCH_RLE_MAX];
+    frame_t source = image->frame;
+    frame_t decoded;
+
+    if(reference) {
+        for(size_t i = 0; i < sizeof(source.data); i++) {
+            source.data[i] ^= reference->data[i];
+        }
+    }
+
+    const size_t size = bench_rle_encode(
+        encoded, source.data, sizeof(source.data), reference ? ScreenCodecDeltaRle :
+                                                               ScreenCodecRle);
+
+    screen_decoder_t decoder;
+    screen_decoder_init(&decoder, &decoded, reference);
+    const bool success = screen_decoder_feed(&decoder, encoded, size) &&
+                         screen_decoder_done(&decoder) &&
+                         memcmp(decoded.data, image->frame.data, sizeof(decoded.data)) == 0;
+
+    if(!success) {
+        printf("  MISMATCH %s: codec round trip\n", image->name);
+    }
+
+    return success;
+}
+
+// In-memory loopback standing in for the UART, both directions of the link share it
+#define BENCH_LOOPBACK_SIZE 4096
+
+typedef struct {
+    uint8_t data[BENCH_LOOPBACK_SIZE];
+    size_t head;
+    size_t tail;
+    // Bytes that went over the wire since the last reset
+    size_t wire_bytes;
+} bench_loopback_t;
+
+static size_t bench_loopback_send(const uint8_t* data, size_t data_size, void* context) {
+    bench_loopback_t* loopback = context;
+
+    if(loopback->head + data_size > BENCH_LOOPBACK_SIZE) return 0;
+
+    memcpy(&loopback->data[loopback->head], data, data_size);
+    loopback->head += data_size;
+    loopback->wire_bytes += data_size;
+    return data_size;
+}
+
+static size_t bench_loopback_receive(uint8_t* data, size_t data_size, void* context) {
+    bench_loopback_t* loopback = context;
+    const size_t available = loopback->head - loopback->tail;
+    const size_t size = data_size < available ? data_size : available;
+
+    memcpy(data, &loopback->data[loopback->tail], size);
+    loopback->tail += size;
+    if(loopback->tail == loopback->head) {
+        loopback->head = loopback->tail = 0;
+    }
+    return size;
+}
+
+// The per-pixel loop bitmap_xbm_to_screen_frame() had before the 8x8 transpose
+static void bench_reference_xbm(uint8_t* dst, const uint8_t* src, size_t w, size_t h) {
+    memset(dst, 0, w * h / 8);
+
+    for(size_t y = 0; y < h; ++y) {
+        for(size_t x = 0; x < w; ++x) {
+            if(src[(y * w + x) / 8] & (1 << (x % 8))) {
+                dst[y / 8 * w + x] |= 1 << (y % 8);
+            }
+        }
+    }
+}
+
+static bool bench_check_xbm_image(const char* name, const uint8_t* xbm) {
+    frame_t expected;
+    frame_t converted;
+
+    bench_reference_xbm(expected.data, xbm, FLIPPER_SCREEN_WIDTH, FLIPPER_SCREEN_HEIGHT);
+    // The converter must write every byte itself
+    memset(converted.data, 0xA5, sizeof(converted.data));
+    bitmap_xbm_to_screen_frame(converted.data, xbm, FLIPPER_SCREEN_WIDTH, FLIPPER_SCREEN_HEIGHT);
+
+    const bool success = memcmp(converted.data, expected.data, sizeof(expected.data)) == 0;
+    if(!success) {
+        printf("  MISMATCH %s: xbm conversion vs per-pixel reference\n", name);
+    }
+
+    return success;
+}
+
+static bool bench_check_xbm(void) {
+    bool success = bench_check_xbm_image("splash", bitmap_splash_screen);
+    success &= bench_check_xbm_image("default", default_bits);
+
+    uint8_t xbm[FLIPPER_BITMAP_SIZE];
+    uint32_t seed = 0x9E3779B9;
+    for(size_t image = 0; image < 8; image++) {
+        for(size_t i = 0; i < sizeof(xbm); i++) {
+            seed = seed * 1664525 + 1013904223;
+            xbm[i] = seed >> 24;
+        }
+        success &= bench_check_xbm_image("random bitmap", xbm);
+    }
+
+    return success;
+}
+
+// scripts/build_assets.py has its own XBM conversion and RLE encoder: the packed screen
+// decoded by the firmware's player must be the firmware's conversion of the same file
+static bool bench_check_asset(void) {
+    frame_t expected;
+    frame_t decoded;
+
+    bitmap_xbm_to_screen_frame(expected.data, default_bits, default_width, default_height);
+
+    const bool success = screen_asset_draw("default", &decoded) &&
+                         memcmp(decoded.data, expected.data, sizeof(decoded.data)) == 0;
+    if(!success) {
+        printf("  MISMATCH default asset: packed screen vs converted XBM\n");
+    }
+
+    return success;
+}
+
+// One frame through the loopback, it must come back the same with a good checksum
+static bool bench_check_frame(const ExpansionFrame* frame, const char* name) {
+    bench_loopback_t loopback = {0};
+    ExpansionFrame received = {0};
+
+    const bool success =
+        expansion_protocol_encode(frame, bench_loopback_send, &loopback) ==
+            ExpansionProtocolStatusOk &&
+        loopback.head == expansion_frame_get_encoded_size(frame) + 1 &&
+        expansion_protocol_decode(&received, bench_loopback_receive, &loopback) ==
+            ExpansionProtocolStatusOk &&
+        memcmp(&received, frame, expansion_frame_get_encoded_size(frame)) == 0;
+
+    if(!success) {
+        printf("  MISMATCH %s frame round trip\n", name);
+    }
+
+    return success;
+}
+
+static bool bench_check_protocol(void) {
+    bool success = true;
+    ExpansionFrame frame = {.header.type = ExpansionFrameTypeData};
+
+    frame.content.data.size = EXPANSION_PROTOCOL_MAX_DATA_SIZE;
+    for(size_t i = 0; i < EXPANSION_PROTOCOL_MAX_DATA_SIZE; i++) {
+        frame.content.data.bytes[i] = i * 31 + 7;
+    }
+    success &= bench_check_frame(&frame, "data");
+
+    const ExpansionFrame heartbeat = {.header.type = ExpansionFrameTypeHeartbeat};
+    const ExpansionFrame status = {
+        .header.type = ExpansionFrameTypeStatus,
+        .content.status.error = ExpansionFrameErrorBaudRate,
+    };
+    const ExpansionFrame baud_rate = {
+        .header.type = ExpansionFrameTypeBaudRate,
+        .content.baud_rate.baud = 1843200,
+    };
+    const ExpansionFrame control = {
+        .header.type = ExpansionFrameTypeControl,
+        .content.control.command = ExpansionFrameControlCommandStartRpcWindowed,
+    };
+    success &= bench_check_frame(&heartbeat, "heartbeat");
+    success &= bench_check_frame(&status, "status");
+    success &= bench_check_frame(&baud_rate, "baud rate");
+    success &= bench_check_frame(&control, "control");
+
+    // A flipped bit fails the checksum, a short frame the read, an unknown type the format
+    bench_loopback_t loopback = {0};
+    ExpansionFrame received;
+
+    expansion_protocol_encode(&frame, bench_loopback_send, &loopback);
+    loopback.data[10] ^= 0x04;
+    if(expansion_protocol_decode(&received, bench_loopback_receive, &loopback) !=
+       ExpansionProtocolStatusErrorChecksum) {
+        printf("  MISMATCH corrupted data frame not rejected\n");
+        success = false;
+    }
+
+    loopback = (bench_loopback_t){0};
+    expansion_protocol_encode(&frame, bench_loopback_send, &loopback);
+    loopback.head -= 2;
+    if(expansion_protocol_decode(&received, bench_loopback_receive, &loopback) !=
+       ExpansionProtocolStatusErrorCommunication) {
+        printf("  MISMATCH truncated data frame not rejected\n");
+        success = false;
+    }
+
+    loopback = (bench_loopback_t){.head = 1, .data = {ExpansionFrameTypeReserved}};
+    if(expansion_protocol_decode(&received, bench_loopback_receive, &loopback) !=
+       ExpansionProtocolStatusErrorFormat) {
+        printf("  MISMATCH unknown frame type not rejected\n");
+        success = false;
+    }
+
+    return success;
+}
+
+static bool bench_verify(void) {
+    bool success = true;
+    lut_row_t lut;
+    lut_row_build(&lut, BENCH_BG, BENCH_FG);
+
+    printf("verify\n");
+    for(size_t i = 0; i < bench_images_count; i++) {
+        const bench_image_t* image = &bench_images[i];
+
+        for(unsigned orientation = 0; orientation < BenchOrientationCount; orientation++) {
+            success &= bench_check_kernel(image, orientation, 1, &lut);
+            if(orientation < BenchOrientationVertical) {
+                success &= bench_check_kernel(image, orientation, 2, &lut);
+            }
+        }
+
+        success &= bench_check_codec(image, NULL);
+        success &= bench_check_codec(image, &bench_images[0].frame);
+    }
+    success &= bench_check_xbm();
+    success &= bench_check_asset();
+    success &= bench_check_protocol();
+    printf("  %s\n", success ? "all kernels, codecs and frames match the reference" : "FAILED");
+
+    return success;
+}
+
+typedef struct {
+    const frame_t* frame;
+    BenchOrientation orientation;
+    unsigned columns;
+    lut_row_t lut;
+    uint32_t line[BENCH_LINE_PAIRS];
+} bench_kernel_context_t;
+
+// A whole picture, one row after the other into the same line
+static void bench_kernel_frame(void* context) {
+    bench_kernel_context_t* kernel = context;
+
+    for(unsigned row = 0; row < bench_rows(kernel->orientation); row++) {
+        bench_kernel_row(
+            kernel->line,
+            kernel->frame,
+            kernel->orientation,
+            kernel->columns,
+            row,
+            &kernel->lut);
+    }
+    bench_sink = kernel->line[0];
+}
+
+static void bench_lut_build(void* context) {
+    bench_kernel_context_t* kernel = context;
+    lut_row_build(&kernel->lut, (uint16_t)bench_sink, BENCH_FG);
+    bench_sink = kernel->lut.h1r[1];
+}
+
+static void bench_border(void* context) {
+    bench_kernel_context_t* kernel = context;
+    // The widest letterbox: 2x horizontal leaves 192 of the 320 pixels to the borders
+    kernel_fill(&kernel->line[0], 32, kernel->lut.h[0]);
+    kernel_fill(&kernel->line[96], 64, kernel->lut.h[0]);
+    bench_sink = kernel->line[100];
+}
+
+static void bench_kernels(void) {
+    static const struct {
+        const char* name;
+        BenchOrientation orientation;
+        unsigned columns;
+    } cases[] = {
+        {"scanline_h 2x", BenchOrientationHorizontal, 1},
+        {"scanline_h 4x", BenchOrientationHorizontal, 2},
+        {"scanline_h_flip 2x", BenchOrientationHorizontalFlip, 1},
+        {"scanline_h_flip 4x", BenchOrientationHorizontalFlip, 2},
+        {"scanline_v clockwise", BenchOrientationVertical, 1},
+        {"scanline_v counter-clockwise", BenchOrientationVerticalFlip, 1},
+    };
+    bench_kernel_context_t kernel = {.frame = &bench_images[0].frame};
+    lut_row_build(&kernel.lut, BENCH_BG, BENCH_FG);
+
+    printf("scanline kernels, whole picture\n");
+    for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        kernel.orientation = cases[i].orientation;
+        kernel.columns = cases[i].columns;
+        bench_report(
+            cases[i].name,
+            bench_measure(bench_kernel_frame, &kernel),
+            bench_rows(kernel.orientation),
+            "line");
+    }
+    bench_report("lut_row_build", bench_measure(bench_lut_build, &kernel), 1, NULL);
+    bench_report("borders, 2x", bench_measure(bench_border, &kernel), 1, NULL);
+}
+
+static void bench_xbm(void* context) {
+    frame_t* frame = context;
+    bitmap_xbm_to_screen_frame(
+        frame->data, bitmap_splash_screen, FLIPPER_SCREEN_WIDTH, FLIPPER_SCREEN_HEIGHT);
+    bench_sink = frame->data[0];
+}
+
+typedef struct {
+    uint8_t encoded[BENCH_RLE_MAX];
+    size_t size;
+    const frame_t* reference;
+    frame_t frame;
+} bench_codec_context_t;
+
+static void bench_decode(void* context) {
+    bench_codec_context_t* codec = context;
+    screen_decoder_t decoder;
+
+    screen_decoder_init(&decoder, &codec->frame, codec->reference);
+    screen_decoder_feed(&decoder, codec->encoded, codec->size);
+    bench_sink = codec->frame.data[0];
+}
+
+static void bench_bitmaps(void) {
+    static bench_codec_context_t codec;
+    frame_t frame;
+
+    printf("bitmaps and screen codec\n");
+    bench_report("bitmap_xbm_to_screen_frame", bench_measure(bench_xbm, &frame), 1, NULL);
+
+    for(size_t i = 0; i < bench_images_count; i++) {
+        const bench_image_t* image = &bench_images[i];
+        char name[64];
+
+        codec.reference = NULL;
+        codec.size = bench_rle_encode(
+            codec.encoded, image->frame.data, sizeof(image->frame.data), ScreenCodecRle);
+        snprintf(name, sizeof(name), "decode rle %s, %zu bytes", image->name, codec.size);
+        bench_report(name, bench_measure(bench_decode, &codec), 1, NULL);
+    }
+}
+
+typedef struct {
+    bench_loopback_t loopback;
+    const uint8_t* message;
+    size_t message_size;
+    uint8_t received[BENCH_RLE_MAX + BENCH_RPC_OVERHEAD];
+    size_t received_size;
+    bool failed;
+} bench_link_context_t;
+
+// One RPC message in data frames, each one with its status back in windowed mode
+static void bench_link_transfer(void* context) {
+    bench_link_context_t* link = context;
+    size_t data_frames = 0;
+
+    link->received_size = 0;
+    for(size_t offset = 0; offset < link->message_size;) {
+        ExpansionFrame frame = {.header.type = ExpansionFrameTypeData};
+        const size_t left = link->message_size - offset;
+        const size_t size =
+            left < EXPANSION_PROTOCOL_MAX_DATA_SIZE ? left : EXPANSION_PROTOCOL_MAX_DATA_SIZE;
+
+        frame.content.data.size = size;
+        memcpy(frame.content.data.bytes, &link->message[offset], size);
+        offset += size;
+        data_frames++;
+
+        ExpansionFrame received;
+        if(expansion_protocol_encode(&frame, bench_loopback_send, &link->loopback) !=
+               ExpansionProtocolStatusOk ||
+           expansion_protocol_decode(&received, bench_loopback_receive, &link->loopback) !=
+               ExpansionProtocolStatusOk) {
+            link->failed = true;
+            return;
+        }
+
+        memcpy(
+            &link->received[link->received_size],
+            received.content.data.bytes,
+            received.content.data.size);
+        link->received_size += received.content.data.size;
+
+        // The status goes the other way and doesn't take bandwidth from the data
+        if(data_frames % EXPANSION_PROTOCOL_WINDOW_SIZE == 0 || offset == link->message_size) {
+            const size_t wire_bytes = link->loopback.wire_bytes;
+            ExpansionFrame status = {
+                .header.type = ExpansionFrameTypeStatus,
+                .content.status.error = ExpansionFrameErrorNone,
+            };
+            expansion_protocol_encode(&status, bench_loopback_send, &link->loopback);
+            expansion_protocol_decode(&received, bench_loopback_receive, &link->loopback);
+            link->loopback.wire_bytes = wire_bytes;
+        }
+    }
+}
+
+static void bench_checksum(void* context) {
+    const uint8_t* data = context;
+    bench_sink = expansion_protocol_get_checksum(data, EXPANSION_PROTOCOL_MAX_DATA_SIZE + 2);
+}
+
+// Bytes on the wire for one screen frame message of the given size
+static size_t bench_link_wire_bytes(bench_link_context_t* link, size_t message_size) {
+    static uint8_t message[BENCH_RLE_MAX + BENCH_RPC_OVERHEAD];
+
+    for(size_t i = 0; i < message_size; i++) {
+        message[i] = i * 7;
+    }
+
+    link->message = message;
+    link->message_size = message_size;
+    link->loopback.wire_bytes = 0;
+    bench_link_transfer(link);
+
+    if(link->failed || link->received_size != message_size ||
+       memcmp(link->received, message, message_size) != 0) {
+        link->failed = true;
+    }
+
+    return link->loopback.wire_bytes;
+}
+
+static bool bench_link(void) {
+    static const uint32_t baud_rates[] = {
+        4000000,
+        3000000,
+        2000000,
+        1843200,
+        921600,
+        460800,
+        230400,
+        115200,
+        EXPANSION_PROTOCOL_DEFAULT_BAUD_RATE,
+    };
+    static bench_link_context_t link;
+    uint8_t data[EXPANSION_PROTOCOL_MAX_DATA_SIZE + 2] = {0};
+
+    printf("expansion protocol\n");
+    bench_report("expansion_protocol_get_checksum", bench_measure(bench_checksum, data), 66, "B");
+
+    // Wire bytes per screen: raw, and RLE for every test image
+    size_t wire[1 + sizeof(bench_images) / sizeof(bench_images[0])];
+    wire[0] = bench_link_wire_bytes(&link, sizeof(frame_t) + BENCH_RPC_OVERHEAD);
+
+    // The raw message is still set up
+    bench_report(
+        "encode + decode, one raw screen",
+        bench_measure(bench_link_transfer, &link),
+        (link.message_size + EXPANSION_PROTOCOL_MAX_DATA_SIZE - 1) /
+            EXPANSION_PROTOCOL_MAX_DATA_SIZE,
+        "frame");
+
+    for(size_t i = 0; i < bench_images_count; i++) {
+        uint8_t encoded[BENCH_RLE_MAX];
+        const size_t size = bench_rle_encode(
+            encoded, bench_images[i].frame.data, sizeof(frame_t), ScreenCodecRle);
+        wire[i + 1] = bench_link_wire_bytes(&link, size + BENCH_RPC_OVERHEAD);
+    }
+
+    if(link.failed) {
+        printf("  MISMATCH loopback transfer\n");
+        return false;
+    }
+
+    printf("simulated UART, screen frames per second (limit %d)\n", BENCH_FPS_MAX);
+    printf("  %-9s %10s", "baud", "raw");
+    for(size_t i = 0; i < bench_images_count; i++) {
+        printf(" %12s", bench_images[i].name);
+    }
+    printf("\n  %-9s %10zu", "bytes", wire[0]);
+    for(size_t i = 0; i < bench_images_count; i++) {
+        printf(" %12zu", wire[i + 1]);
+    }
+    printf("\n");
+
+    for(size_t rate = 0; rate < sizeof(baud_rates) / sizeof(baud_rates[0]); rate++) {
+        printf("  %-9u", baud_rates[rate]);
+        for(size_t i = 0; i <= bench_images_count; i++) {
+            const double fps =
+                (double)baud_rates[rate] / BENCH_UART_BITS_PER_BYTE / (double)wire[i];
+            printf(i == 0 ? " %10.1f" : " %12.1f", fps < BENCH_FPS_MAX ? fps : BENCH_FPS_MAX);
+        }
+        printf("\n");
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv) {
+    bench_images_init();
+
+    if(!bench_verify()) {
+        return EXIT_FAILURE;
+    }
+    // The checks alone, for ctest
+    if(argc > 1 && strcmp(argv[1], "--verify") == 0) {
+        return EXIT_SUCCESS;
+    }
+
+    bench_kernels();
+    bench_bitmaps();
+
+    return bench_link() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -59,20 +59,39 @@
                                                             // than the number of bytes in a size_t.
 
 /* Memory allocation related definitions. */
+#ifdef VGM_STATIC_ALLOCATION
+#define configSUPPORT_STATIC_ALLOCATION         1           // All objects are static, no FreeRTOS heap
+#define configSUPPORT_DYNAMIC_ALLOCATION        0
+#else
 #define configSUPPORT_STATIC_ALLOCATION         0
 #define configSUPPORT_DYNAMIC_ALLOCATION        1           // Get FreeRTOS to allocation task memory
+#endif
 #define configAPPLICATION_ALLOCATED_HEAP        1
 
 /* Hook function related definitions. */
 #define configUSE_IDLE_HOOK                     0
 #define configUSE_TICK_HOOK                     0
+#ifdef VGM_INSTRUMENTATION
+#define configCHECK_FOR_STACK_OVERFLOW          2           // Stack limit and fill pattern checked at every switch
+#else
 #define configCHECK_FOR_STACK_OVERFLOW          0
+#endif
 #define configUSE_MALLOC_FAILED_HOOK            0
 #define configUSE_DAEMON_TASK_STARTUP_HOOK      0
 
 /* Run time and task stats gathering related definitions. */
+#ifdef VGM_INSTRUMENTATION
+#define configGENERATE_RUN_TIME_STATS           1           // Run time in us from the RP2040 timer, wraps after 71 minutes
+#define configUSE_TRACE_FACILITY                1
+#ifndef __ASSEMBLER__
+unsigned long instrumentation_get_run_time_counter(void);
+#endif
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()            // The timer always runs
+#define portGET_RUN_TIME_COUNTER_VALUE()        instrumentation_get_run_time_counter()
+#else
 #define configGENERATE_RUN_TIME_STATS           0
 #define configUSE_TRACE_FACILITY                0
+#endif
 #define configUSE_STATS_FORMATTING_FUNCTIONS    0
 
 /* Co-routine related definitions. */
@@ -98,7 +117,11 @@
 #define INCLUDE_vTaskDelay                      1
 #define INCLUDE_xTaskGetSchedulerState          1
 #define INCLUDE_xTaskGetCurrentTaskHandle       1
+#ifdef VGM_INSTRUMENTATION
+#define INCLUDE_uxTaskGetStackHighWaterMark     1
+#else
 #define INCLUDE_uxTaskGetStackHighWaterMark     0
+#endif
 #define INCLUDE_xTaskGetIdleTaskHandle          0
 #define INCLUDE_eTaskGetState                   0
 #define INCLUDE_xEventGroupSetBitFromISR        1
@@ -0,0 +1,290 @@
+#!/usr/bin/env python3
+
+"""Pack the screen assets into a compressed C source for the firmware.
+
+Every XBM or PNG file in the assets directory is a screen named after the file, and every
+subdirectory is an animation named after the directory, its frames in file name order.
+Images must be 128x64, PNG pixels darker than mid grey are drawn.
+
+Frames are stored in the screen codec format (see app/screen_codec.h): the first frame of an
+asset as ScreenCodecRle, the following ones as ScreenCodecDeltaRle against the frame before,
+so a frame that barely changes costs a few bytes. Each frame is prefixed with its encoded size
+as a 16 bit little endian value, and the frames of an asset follow each other in flash.
+"""
+
+import argparse
+import pathlib
+import re
+import struct
+import sys
+import zlib
+
+WIDTH = 128
+HEIGHT = 64
+FRAME_SIZE = WIDTH * HEIGHT // 8
+
+CODEC_RLE = 0x01
+CODEC_DELTA_RLE = 0x02
+
+RUN = 0x80
+COUNT_MAX = 0x80
+# A run shorter than this is cheaper as part of a literal
+RUN_MIN = 3
+
+EXTENSIONS = (".xbm", ".png")
+
+XBM_SIZE_RE = re.compile(r"#define\s+\w*_(width|height)\s+(\d+)")
+XBM_DATA_RE = re.compile(r"\{(.*)\}", re.S)
+PNG_SIGNATURE = b"\x89PNG\r\n\x1a\n"
+
+
+def parse_args():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("assets", help="Assets directory")
+    parser.add_argument("output", help="Generated C file")
+    return parser.parse_args()
+
+
+def load_xbm(path):
+    text = path.read_text()
+    size = {key: int(value) for key, value in XBM_SIZE_RE.findall(text)}
+    data = XBM_DATA_RE.search(text)
+    if data is None or "width" not in size or "height" not in size:
+        raise ValueError("not an XBM file")
+
+    width, height = size["width"], size["height"]
+    data = [int(value, 0) for value in data.group(1).replace(",", " ").split()]
+    stride = (width + 7) // 8
+    if len(data) != stride * height:
+        raise ValueError(f"{len(data)} bytes of data for {width}x{height}")
+
+    # XBM rows are LSB first
+    pixels = [
+        [(data[y * stride + x // 8] >> (x % 8)) & 1 for x in range(width)] for y in range(height)
+    ]
+    return width, height, pixels
+
+
+def png_unfilter(data, height, stride, bpp):
+    rows = []
+    previous = bytearray(stride)
+    offset = 0
+
+    for _ in range(height):
+        kind = data[offset]
+        row = bytearray(data[offset + 1 : offset + 1 + stride])
+        offset += 1 + stride
+
+        for i in range(stride):
+            left = row[i - bpp] if i >= bpp else 0
+            up = previous[i]
+            up_left = previous[i - bpp] if i >= bpp else 0
+            if kind == 1:
+                row[i] = (row[i] + left) & 0xFF
+            elif kind == 2:
+                row[i] = (row[i] + up) & 0xFF
+            elif kind == 3:
+                row[i] = (row[i] + (left + up) // 2) & 0xFF
+            elif kind == 4:
+                p = left + up - up_left
+                pa, pb, pc = abs(p - left), abs(p - up), abs(p - up_left)
+                predictor = left if pa <= pb and pa <= pc else up if pb <= pc else up_left
+                row[i] = (row[i] + predictor) & 0xFF
+            elif kind != 0:
+                raise ValueError(f"unknown filter {kind}")
+
+        rows.append(row)
+        previous = row
+
+    return rows
+
+
+def load_png(path):
+    data = path.read_bytes()
+    if not data.startswith(PNG_SIGNATURE):
+        raise ValueError("not a PNG file")
+
+    chunks = {}
+    offset = len(PNG_SIGNATURE)
+    while offset < len(data):
+        (length,) = struct.unpack(">I", data[offset : offset + 4])
+        kind = data[offset + 4 : offset + 8]
+        chunks.setdefault(kind, []).append(data[offset + 8 : offset + 8 + length])
+        offset += 12 + length
+
+    width, height, depth, color, _, _, interlace = struct.unpack(">IIBBBBB", chunks[b"IHDR"][0])
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}.get(color)
+    if channels is None or interlace != 0:
+        raise ValueError("unsupported PNG format")
+    if depth != 8 and (color not in (0, 3) or depth > 8):
+        raise ValueError(f"unsupported bit depth {depth}")
+
+    bits = depth * channels
+    stride = (width * bits + 7) // 8
+    compressed = b"".join(chunks[b"IDAT"])
+    rows = png_unfilter(zlib.decompress(compressed), height, stride, max(1, bits // 8))
+
+    palette = None
+    if color == 3:
+        raw = chunks[b"PLTE"][0]
+        palette = [tuple(raw[i : i + 3]) for i in range(0, len(raw), 3)]
+
+    def luma(row, x):
+        if depth < 8:
+            shift = 8 - depth - (x * depth) % 8
+            value = (row[x * depth // 8] >> shift) & ((1 << depth) - 1)
+            if palette is not None:
+                r, g, b = palette[value]
+                return (r * 299 + g * 587 + b * 114) // 1000
+            return value * 255 // ((1 << depth) - 1)
+
+        pixel = row[x * channels : (x + 1) * channels]
+        if palette is not None:
+            r, g, b = palette[pixel[0]]
+        elif channels >= 3:
+            r, g, b = pixel[:3]
+        else:
+            r = g = b = pixel[0]
+        value = (r * 299 + g * 587 + b * 114) // 1000
+        # Transparent pixels are background
+        if channels in (2, 4) and pixel[-1] < 128:
+            value = 255
+        return value
+
+    pixels = [[1 if luma(row, x) < 128 else 0 for x in range(width)] for row in rows]
+    return width, height, pixels
+
+
+def load_frame(path):
+    loader = load_xbm if path.suffix.lower() == ".xbm" else load_png
+    width, height, pixels = loader(path)
+    if (width, height) != (WIDTH, HEIGHT):
+        raise ValueError(f"image is {width}x{height}, expected {WIDTH}x{HEIGHT}")
+
+    # Screen frame format: one byte per 8-row column, LSB on top
+    frame = bytearray(FRAME_SIZE)
+    for y in range(HEIGHT):
+        for x in range(WIDTH):
+            if pixels[y][x]:
+                frame[(y // 8) * WIDTH + x] |= 1 << (y % 8)
+    return bytes(frame)
+
+
+def rle_encode(data):
+    output = bytearray()
+    literal = bytearray()
+
+    def flush_literal():
+        while literal:
+            chunk = literal[:COUNT_MAX]
+            output.append(len(chunk) - 1)
+            output.extend(chunk)
+            del literal[:COUNT_MAX]
+
+    offset = 0
+    while offset < len(data):
+        run = 1
+        while offset + run < len(data) and run < COUNT_MAX and data[offset + run] == data[offset]:
+            run += 1
+
+        if run >= RUN_MIN:
+            flush_literal()
+            output.append(RUN | (run - 1))
+            output.append(data[offset])
+            offset += run
+        else:
+            literal.append(data[offset])
+            offset += 1
+
+    flush_literal()
+    return bytes(output)
+
+
+def encode_asset(frames):
+    records = bytearray()
+    previous = None
+
+    for frame in frames:
+        if previous is None:
+            encoded = bytes([CODEC_RLE]) + rle_encode(frame)
+        else:
+            delta = bytes(a ^ b for a, b in zip(frame, previous))
+            encoded = bytes([CODEC_DELTA_RLE]) + rle_encode(delta)
+        records += struct.pack("<H", len(encoded)) + encoded
+        previous = frame
+
+    return bytes(records)
+
+
+def find_assets(root):
+    assets = []
+    for path in sorted(root.iterdir()):
+        if path.is_dir():
+            frames = sorted(p for p in path.iterdir() if p.suffix.lower() in EXTENSIONS)
+            if frames:
+                assets.append((path.name, frames))
+        elif path.suffix.lower() in EXTENSIONS:
+            assets.append((path.stem, [path]))
+    return assets
+
+
+def write_source(output, assets):
+    lines = [
+        "// Generated by scripts/build_assets.py, do not edit",
+        '#include "screen_assets.h"',
+        "",
+        "static const uint8_t screen_assets_data[] = {",
+    ]
+
+    table = []
+    offset = 0
+    for name, frame_count, data in assets:
+        lines.append(f"    // {name}: {frame_count} frame(s), {len(data)} bytes")
+        for i in range(0, len(data), 16):
+            lines.append("    " + " ".join(f"0x{b:02x}," for b in data[i : i + 16]))
+        table.append(f'    {{"{name}", {frame_count}, &screen_assets_data[{offset}]}},')
+        offset += len(data)
+
+    lines += [
+        "};",
+        "",
+        "const screen_asset_t screen_assets[] = {",
+        *table,
+        "};",
+        "",
+        f"const size_t screen_assets_count = {len(table)};",
+        "",
+    ]
+
+    text = "\n".join(lines)
+    if not output.exists() or output.read_text() != text:
+        output.write_text(text)
+
+
+def main():
+    args = parse_args()
+    assets = []
+
+    for name, paths in find_assets(pathlib.Path(args.assets)):
+        if not re.fullmatch(r"[A-Za-z0-9_\-]+", name):
+            print(f"error: invalid asset name '{name}'", file=sys.stderr)
+            return 1
+        try:
+            frames = [load_frame(path) for path in paths]
+        except (ValueError, KeyError, zlib.error) as error:
+            print(f"error: {name}: {error}", file=sys.stderr)
+            return 1
+        assets.append((name, len(frames), encode_asset(frames)))
+
+    if not assets:
+        print(f"error: no assets in {args.assets}", file=sys.stderr)
+        return 1
+
+    write_source(pathlib.Path(args.output), assets)
+    size = sum(len(data) for _, _, data in assets)
+    print(f"{len(assets)} asset(s), {size} bytes")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+
+"""Check that every function reachable from the core1 entry points runs from RAM.
+
+The call graph is taken from the disassembly of the ELF: direct branches are followed,
+linker veneers are resolved to the function they jump to. Calls through function pointers
+can't be seen, so their targets have to be given as extra roots.
+"""
+
+import argparse
+import re
+import subprocess
+import sys
+
+FLASH_START = 0x10000000
+FLASH_END = 0x11000000
+
+# Renamed, inlined or LTO-suffixed, this one fails the check instead of being skipped
+REQUIRED_ROOT = "core1_main"
+
+DEFAULT_ROOTS = [
+    REQUIRED_ROOT,
+    "core1_scanline_callback",
+    "dvi_dma0_irq",
+    "dvi_dma1_irq",
+]
+
+FUNCTION_RE = re.compile(r"^([0-9a-f]+) <(.+)>:$")
+CALL_RE = re.compile(r"\s(?:bl|blx|b|b\.n|b\.w|b[a-z]{2}(?:\.n|\.w)?)\s+([0-9a-f]+) <([^>+]+)")
+VENEER_RE = re.compile(r"^__(.+)_veneer$")
+
+
+def parse_args():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("elf", help="Firmware ELF file")
+    parser.add_argument("--objdump", default="arm-none-eabi-objdump", help="objdump binary")
+    parser.add_argument(
+        "--root",
+        action="append",
+        default=[],
+        help="Additional entry point, e.g. a function only called through a pointer",
+    )
+    parser.add_argument(
+        "--warn-only",
+        action="store_true",
+        help="Report functions in flash, but don't fail",
+    )
+    return parser.parse_args()
+
+
+def load_call_graph(objdump, elf):
+    output = subprocess.run(
+        [objdump, "-d", "--no-show-raw-insn", elf],
+        check=True,
+        capture_output=True,
+        text=True,
+    ).stdout
+
+    addresses = {}
+    calls = {}
+    function = None
+
+    for line in output.splitlines():
+        match = FUNCTION_RE.match(line)
+        if match:
+            function = match.group(2)
+            addresses[function] = int(match.group(1), 16)
+            calls.setdefault(function, set())
+            continue
+
+        if function is None:
+            continue
+
+        match = CALL_RE.search(line)
+        if match and match.group(2) != function:
+            calls[function].add(match.group(2))
+
+    return addresses, calls
+
+
+def is_in_flash(address):
+    return FLASH_START <= address < FLASH_END
+
+
+def find_flash_functions(roots, addresses, calls):
+    # function -> function it was reached from, for the report
+    reached = {root: None for root in roots}
+    pending = list(roots)
+
+    while pending:
+        function = pending.pop()
+        targets = set(calls.get(function, ()))
+
+        # A veneer stands for the long branch to the real function
+        match = VENEER_RE.match(function)
+        if match:
+            targets.add(match.group(1))
+
+        for target in targets:
+            if target not in reached:
+                reached[target] = function
+                pending.append(target)
+
+    flash = []
+    for function, parent in reached.items():
+        address = addresses.get(function)
+        if address is not None and is_in_flash(address):
+            flash.append((function, address, parent))
+
+    return sorted(flash, key=lambda item: item[1])
+
+
+def main():
+    args = parse_args()
+    addresses, calls = load_call_graph(args.objdump, args.elf)
+
+    roots = [root for root in DEFAULT_ROOTS + args.root if root in addresses]
+    missing = [root for root in DEFAULT_ROOTS + args.root if root not in addresses]
+    for root in missing:
+        print(f"warning: entry point {root} not found", file=sys.stderr)
+
+    # Without the core1 entry point the audit would walk nothing and pass, whatever is in flash
+    if REQUIRED_ROOT not in roots:
+        print(f"error: {REQUIRED_ROOT} not found, nothing to check", file=sys.stderr)
+        return 1
+
+    flash = find_flash_functions(roots, addresses, calls)
+    for function, address, parent in flash:
+        print(f"{address:08x} {function} (called from {parent})")
+
+    if flash:
+        print(f"{len(flash)} function(s) reachable from core1 are in flash", file=sys.stderr)
+        return 0 if args.warn_only else 1
+
+    print(f"All functions reachable from {', '.join(roots)} are in RAM")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())